@@ -0,0 +1,162 @@
+/*
+ * Bump allocator for per-document allocations.
+ *
+ * Project: svg2ass
+ *    File: arena.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * Memory is handed out sequentially from a chain of blocks and only
+ * ever returned as a whole: arenaRelease() rolls back to a previous
+ * mark, arenaReset() empties the arena. Blocks are kept for reuse, so
+ * both are O(1), and once the arena has grown to the size a workload
+ * needs, converting further documents does not touch malloc at all.
+ * A zero initialized arena_t is a valid, empty arena.
+ */
+
+#include <string.h>
+
+#include "arena.h"
+
+
+#define ARENA_ALIGN		16
+#define ARENA_DFLT_BLK	( 64 * 1024 )
+#define ALIGN_UP(N)		( ( (N) + ARENA_ALIGN - 1 ) & ~(size_t)( ARENA_ALIGN - 1 ) )
+
+struct arenaBlock {
+	arenaBlock_t *next;
+	size_t sz;		// usable size
+	size_t off;		// allocation offset
+	unsigned char *mem;
+};
+
+void arenaInit( arena_t *a, size_t blksz )
+{
+	memset( a, 0, sizeof *a );
+	a->blksz = blksz ? ALIGN_UP( blksz ) : ARENA_DFLT_BLK;
+}
+
+static arenaBlock_t *newBlock( arena_t *a, size_t sz )
+{
+	arenaBlock_t *b;
+	size_t hdr = ALIGN_UP( sizeof *b );
+
+	if ( !a->blksz )
+		a->blksz = ARENA_DFLT_BLK;
+	if ( sz < a->blksz )
+		sz = a->blksz;
+	if ( NULL == ( b = malloc( hdr + sz ) ) )
+		return NULL;
+	b->next = NULL;
+	b->sz = sz;
+	b->off = 0;
+	b->mem = (unsigned char *)b + hdr;
+	a->cap += sz;
+	++a->nblk;
+	return b;
+}
+
+void *arenaAlloc( arena_t *a, size_t sz )
+{
+	arenaBlock_t *b = a->cur;
+	void *p;
+
+	sz = ALIGN_UP( sz ? sz : 1 );
+	if ( !b || b->sz - b->off < sz )
+	{
+		// advance to the next spare block, or link in a new one
+		arenaBlock_t **link = b ? &b->next : &a->first;
+		if ( *link && ( *link )->sz >= sz )
+			b = *link;
+		else
+		{
+			if ( NULL == ( b = newBlock( a, sz ) ) )
+				return NULL;
+			b->next = *link;
+			*link = b;
+		}
+		b->off = 0;
+		a->cur = b;
+	}
+	p = b->mem + b->off;
+	b->off += sz;
+	a->used += sz;
+	if ( a->used > a->high )
+		a->high = a->used;
+	return p;
+}
+
+/*
+ * Resize allocation p, in place if it is the most recent one.
+ */
+void *arenaGrow( arena_t *a, void *p, size_t oldsz, size_t newsz )
+{
+	arenaBlock_t *b = a->cur;
+	size_t o = ALIGN_UP( oldsz ? oldsz : 1 );
+	size_t n = ALIGN_UP( newsz ? newsz : 1 );
+	void *q;
+
+	if ( !p )
+		return arenaAlloc( a, newsz );
+	if ( b && (unsigned char *)p + o == b->mem + b->off
+		&& ( n <= o || b->sz - b->off >= n - o ) )
+	{
+		b->off = b->off - o + n;
+		a->used = a->used - o + n;
+		if ( a->used > a->high )
+			a->high = a->used;
+		return p;
+	}
+	if ( NULL != ( q = arenaAlloc( a, newsz ) ) )
+		memcpy( q, p, oldsz < newsz ? oldsz : newsz );
+	return q;
+}
+
+char *arenaStrdup( arena_t *a, const char *s )
+{
+	size_t len = strlen( s ) + 1;
+	char *d = arenaAlloc( a, len );
+	return d ? memcpy( d, s, len ) : NULL;
+}
+
+arenaMark_t arenaMark( const arena_t *a )
+{
+	arenaMark_t m = { a->cur, a->cur ? a->cur->off : 0, a->used };
+	return m;
+}
+
+void arenaRelease( arena_t *a, arenaMark_t m )
+{
+	a->cur = m.blk;
+	if ( m.blk )
+		m.blk->off = m.off;
+	a->used = m.used;
+}
+
+/*
+ * Discard all allocations and start a new high-water mark.
+ */
+void arenaReset( arena_t *a )
+{
+	a->cur = a->first;
+	if ( a->first )
+		a->first->off = 0;
+	a->used = 0;
+	a->high = 0;
+}
+
+void arenaFree( arena_t *a )
+{
+	arenaBlock_t *b, *n;
+
+	for ( b = a->first; b; b = n )
+	{
+		n = b->next;
+		free( b );
+	}
+	arenaInit( a, a->blksz );
+}
+
+/* EOF */
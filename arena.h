@@ -0,0 +1,54 @@
+/*
+ * Bump allocator for per-document allocations.
+ *
+ * Project: svg2ass
+ *    File: arena.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_ARENA_INCLUDED
+#define H_ARENA_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <stdlib.h>
+
+typedef struct arenaBlock arenaBlock_t;
+
+typedef struct {
+	arenaBlock_t *first;	// block list, kept across resets
+	arenaBlock_t *cur;		// block currently allocated from
+	size_t blksz;			// minimum size of new blocks
+	size_t used;			// bytes in use, including alignment padding
+	size_t high;			// high-water mark of used
+	size_t cap;				// total capacity of all blocks
+	size_t nblk;			// number of blocks
+} arena_t;
+
+typedef struct {
+	arenaBlock_t *blk;
+	size_t off;
+	size_t used;
+} arenaMark_t;
+
+void arenaInit( arena_t *a, size_t blksz );
+void *arenaAlloc( arena_t *a, size_t sz );
+void *arenaGrow( arena_t *a, void *p, size_t oldsz, size_t newsz );
+char *arenaStrdup( arena_t *a, const char *s );
+arenaMark_t arenaMark( const arena_t *a );
+void arenaRelease( arena_t *a, arenaMark_t m );
+void arenaReset( arena_t *a );
+void arenaFree( arena_t *a );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_ARENA_INCLUDED
+
+/* EOF */
@@ -0,0 +1,263 @@
+/*
+ * Binary shape export: writer and reader, see assbin.h for the format.
+ *
+ * Project: svg2ass
+ *    File: assbin.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * Values are encoded byte by byte, so the code does not depend on the
+ * host byte order; the reader is self-contained and can be copied into
+ * consuming projects along with assbin.h.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assbin.h"
+
+
+/************************************************************
+ *	Encoding
+ */
+
+static inline void put16( unsigned char *b, unsigned v )
+{
+	b[0] = v & 0xff;
+	b[1] = ( v >> 8 ) & 0xff;
+}
+
+static inline void put32( unsigned char *b, uint32_t v )
+{
+	b[0] = v & 0xff;
+	b[1] = ( v >> 8 ) & 0xff;
+	b[2] = ( v >> 16 ) & 0xff;
+	b[3] = ( v >> 24 ) & 0xff;
+}
+
+static inline void putf( unsigned char *b, float f )
+{
+	uint32_t v;
+	memcpy( &v, &f, sizeof v );
+	put32( b, v );
+}
+
+static inline unsigned get16( const unsigned char *b )
+{
+	return b[0] | ( b[1] << 8 );
+}
+
+static inline uint32_t get32( const unsigned char *b )
+{
+	return b[0] | ( b[1] << 8 ) | ( (uint32_t)b[2] << 16 ) | ( (uint32_t)b[3] << 24 );
+}
+
+static inline float getf( const unsigned char *b )
+{
+	uint32_t v = get32( b );
+	float f;
+	memcpy( &f, &v, sizeof f );
+	return f;
+}
+
+
+/************************************************************
+ *	Writer
+ */
+
+static int writeHeader( assbinWriter_t *w )
+{
+	unsigned char h[ASSBIN_HDR_SZ] = { 0 };
+
+	memcpy( h, ASSBIN_MAGIC, 4 );
+	put16( h + 4, ASSBIN_VERSION );
+	put16( h + 6, ASSBIN_HDR_SZ );
+	put32( h + 8, w->num );
+	return 1 == fwrite( h, sizeof h, 1, w->fp ) ? 0 : -1;
+}
+
+int assbinCreate( assbinWriter_t *w, const char *fname )
+{
+	w->num = 0;
+	if ( NULL == ( w->fp = fopen( fname, "wb" ) ) )
+		return -1;
+	return writeHeader( w );
+}
+
+int assbinWrite( assbinWriter_t *w, const assbinShape_t *s, const float *xy, const unsigned char *cmd )
+{
+	unsigned char h[ASSBIN_REC_SZ] = { 0 }, b[512];
+	size_t i, n, sz = ASSBIN_REC_SZ + 9 * s->num;
+	static const unsigned char pad[8] = { 0 };
+	int r = 0;
+
+	sz = ( sz + 7 ) & ~(size_t)7;
+	if ( sz > UINT32_MAX )
+	{
+		errno = EFBIG;
+		return -1;
+	}
+	put32( h, sz );
+	put32( h + 4, (uint32_t)s->layer );
+	put32( h + 8, s->start_cs );
+	put32( h + 12, s->end_cs );
+	put32( h + 16, s->fill );
+	put32( h + 20, s->stroke );
+	putf( h + 24, s->width );
+	h[28] = s->pexp;
+	for ( i = 0; i < 4; ++i )
+		putf( h + 32 + 4 * i, s->bbox[i] );
+	put32( h + 48, s->num );
+	r |= 1 != fwrite( h, sizeof h, 1, w->fp );
+	for ( i = 0; i < 2 * s->num && 0 == r; i += n )
+	{
+		for ( n = 0; n < sizeof b / 4 && i + n < 2 * s->num; ++n )
+			putf( b + 4 * n, xy[i + n] );
+		r |= n != fwrite( b, 4, n, w->fp );
+	}
+	if ( s->num )
+		r |= s->num != fwrite( cmd, 1, s->num, w->fp );
+	n = sz - ASSBIN_REC_SZ - 9 * s->num;
+	if ( n )
+		r |= n != fwrite( pad, 1, n, w->fp );
+	if ( r )
+		return -1;
+	++w->num;
+	return 0;
+}
+
+/*
+ * Fill in the record count and close the file.
+ */
+int assbinClose( assbinWriter_t *w )
+{
+	int r = 0;
+
+	if ( !w->fp )
+		return 0;
+	if ( 0 != fseek( w->fp, 0, SEEK_SET ) || 0 != writeHeader( w ) )
+		r = -1;
+	if ( 0 != fclose( w->fp ) )
+		r = -1;
+	w->fp = NULL;
+	return r;
+}
+
+
+/************************************************************
+ *	Reader
+ */
+
+int assbinOpen( assbinReader_t *r, const void *data, size_t size )
+{
+	const unsigned char *b = data;
+	unsigned hsz;
+
+	memset( r, 0, sizeof *r );
+	if ( size < ASSBIN_HDR_SZ || 0 != memcmp( b, ASSBIN_MAGIC, 4 )
+		|| ASSBIN_VERSION > get16( b + 4 ) )
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	hsz = get16( b + 6 );
+	if ( hsz < ASSBIN_HDR_SZ || hsz > size )
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	r->base = b;
+	r->size = size;
+	r->p = b + hsz;
+	r->num = get32( b + 8 );
+	return 0;
+}
+
+int assbinMapFile( assbinReader_t *r, const char *fname )
+{
+	struct stat st;
+	void *p;
+	int fd, e;
+
+	if ( 0 > ( fd = open( fname, O_RDONLY ) ) )
+		return -1;
+	if ( 0 != fstat( fd, &st ) )
+	{
+		e = errno;
+		close( fd );
+		errno = e;
+		return -1;
+	}
+	p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	e = errno;
+	close( fd );
+	if ( MAP_FAILED == p )
+	{
+		errno = e;
+		return -1;
+	}
+	if ( 0 != assbinOpen( r, p, st.st_size ) )
+	{
+		munmap( p, st.st_size );
+		errno = EINVAL;
+		return -1;
+	}
+	r->mapped = 1;
+	return 0;
+}
+
+/*
+ * Get the next shape record; returns 1 on success, 0 at the end of
+ * the data, -1 for a malformed record.
+ */
+int assbinNext( assbinReader_t *r, assbinShape_t *s )
+{
+	const unsigned char *b = r->p;
+	size_t left = r->size - ( b - r->base ), sz;
+	int i;
+
+	if ( 0 == left )
+		return 0;
+	if ( left < ASSBIN_REC_SZ )
+		return -1;
+	sz = get32( b );
+	s->num = get32( b + 48 );
+	if ( sz > left || sz < ASSBIN_REC_SZ || ( sz - ASSBIN_REC_SZ ) / 9 < s->num )
+		return -1;
+	s->layer = (int32_t)get32( b + 4 );
+	s->start_cs = get32( b + 8 );
+	s->end_cs = get32( b + 12 );
+	s->fill = get32( b + 16 );
+	s->stroke = get32( b + 20 );
+	s->width = getf( b + 24 );
+	s->pexp = b[28];
+	for ( i = 0; i < 4; ++i )
+		s->bbox[i] = getf( b + 32 + 4 * i );
+	s->pt = b + ASSBIN_REC_SZ;
+	s->cmd = s->pt + 8 * s->num;
+	r->p = b + sz;
+	return 1;
+}
+
+void assbinPoint( const assbinShape_t *s, size_t i, float *x, float *y )
+{
+	*x = getf( s->pt + 8 * i );
+	*y = getf( s->pt + 8 * i + 4 );
+}
+
+void assbinUnmap( assbinReader_t *r )
+{
+	if ( r->mapped )
+		munmap( (void *)r->base, r->size );
+	memset( r, 0, sizeof *r );
+}
+
+/* EOF */
@@ -0,0 +1,105 @@
+/*
+ * Binary shape export: writer and reader.
+ *
+ * Project: svg2ass
+ *    File: assbin.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_ASSBIN_INCLUDED
+#define H_ASSBIN_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * File layout, all values little-endian, records 8 byte aligned, so
+ * the file can be memory mapped and walked in place:
+ *
+ *  header, 16 bytes:
+ *    0  char[4]  magic "S2AB"
+ *    4  u16      format version, ASSBIN_VERSION
+ *    6  u16      header size
+ *    8  u32      number of shape records
+ *   12  u32      reserved, 0
+ *
+ *  shape record, 56 bytes plus data:
+ *    0  u32      record size including data and padding
+ *    4  i32      ASS layer
+ *    8  u32      start time [centiseconds]
+ *   12  u32      end time [centiseconds]
+ *   16  u32      fill color, ASS order: alpha << 24 | blue << 16 | green << 8 | red
+ *   20  u32      stroke (border) color, same order
+ *   24  f32      stroke (border) width
+ *   28  u8       \p scale exponent
+ *   29  u8[3]    reserved, 0
+ *   32  f32[4]   bounding box min x, min y, max x, max y
+ *   48  u32      number of points n
+ *   52  u32      reserved, 0
+ *   56  f32[2n]  points x, y in ASS drawing coordinates (not rounded)
+ *       u8[n]    drawing command per point ('m', 'l', 'b') or 0 to continue
+ *                the previous one, as in the ASS text output
+ *       padding to a multiple of 8 bytes
+ *
+ * Readers must skip records by their size, later versions may append
+ * fields to the record header.
+ */
+
+#define ASSBIN_MAGIC	"S2AB"
+#define ASSBIN_VERSION	1
+#define ASSBIN_HDR_SZ	16
+#define ASSBIN_REC_SZ	56
+
+typedef struct {
+	int layer;
+	unsigned start_cs;
+	unsigned end_cs;
+	unsigned fill;
+	unsigned stroke;
+	float width;
+	int pexp;
+	float bbox[4];
+	size_t num;					// number of points
+	const unsigned char *pt;	// reader: n little-endian f32 x, y pairs
+	const unsigned char *cmd;	// reader: n commands
+} assbinShape_t;
+
+// writer
+typedef struct {
+	FILE *fp;
+	unsigned long num;		// records written
+} assbinWriter_t;
+
+int assbinCreate( assbinWriter_t *w, const char *fname );
+int assbinWrite( assbinWriter_t *w, const assbinShape_t *s, const float *xy, const unsigned char *cmd );
+int assbinClose( assbinWriter_t *w );
+
+// reader
+typedef struct {
+	const unsigned char *base;
+	const unsigned char *p;		// next record
+	size_t size;
+	unsigned long num;			// records in file
+	int mapped;					// base was mapped by assbinMapFile()
+} assbinReader_t;
+
+int assbinOpen( assbinReader_t *r, const void *data, size_t size );
+int assbinMapFile( assbinReader_t *r, const char *fname );
+int assbinNext( assbinReader_t *r, assbinShape_t *s );
+void assbinPoint( const assbinShape_t *s, size_t i, float *x, float *y );
+void assbinUnmap( assbinReader_t *r );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_ASSBIN_INCLUDED
+
+/* EOF */
@@ -0,0 +1,246 @@
+/*
+ * End-to-end benchmark runner for svg2ass.
+ *
+ * Project: svg2ass
+ *    File: bench/bench.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * Runs the converter repeatedly over each input file and prints one
+ * JSON object per input on stdout, e.g.:
+ *   {"case":"path","input_bytes":...,"output_bytes":...,"shapes":...,
+ *    "runs":5,"wall_s":...,"mb_s":...,"shapes_s":...,"peak_rss_kb":...}
+ * Timing is the best (minimum) wall clock time of all runs, peak RSS
+ * the maximum observed. With a baseline converter given, both are run
+ * in turns and its time and the speedup are added, and the geometric
+ * mean speedup over all inputs is printed to stderr at the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+static struct {
+	const char *conv;		// converter binary
+	const char *base;		// baseline converter binary, if any
+	const char *conv_args;	// extra converter arguments, space separated
+	const char *outfile;	// scratch output file
+	int runs;
+} config = {
+	"./svg2ass",
+	NULL,
+	"",
+	"bench.out",
+	5,
+};
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long fsize( const char *fn )
+{
+	struct stat st;
+	return ( 0 == stat( fn, &st ) ) ? (long)st.st_size : -1L;
+}
+
+/*
+ * Count dialogue lines in converter output; with the default ASS mode
+ * this equals the number of converted shapes.
+ */
+static long countShapes( const char *fn )
+{
+	long n = 0;
+	char line[16];
+	int bol = 1, c;
+	FILE *fp;
+
+	if ( NULL == ( fp = fopen( fn, "r" ) ) )
+		return -1;
+	while ( EOF != ( c = getc( fp ) ) )
+	{
+		if ( bol && 'D' == c && fgets( line, 9, fp ) && 0 == strcmp( line, "ialogue:" ) )
+			++n;
+		bol = ( '\n' == c );
+	}
+	fclose( fp );
+	return n;
+}
+
+/*
+ * Run the converter once, return wall clock time, or negative on error.
+ */
+static double runOnce( const char *conv, const char *infile, long *rss_kb )
+{
+	char *argv[64];
+	char *args, *tok;
+	int argc = 0, status, fd;
+	double t0, t1;
+	pid_t pid;
+	struct rusage ru;
+
+	if ( NULL == ( args = strdup( config.conv_args ) ) )
+		return -1.0;
+	argv[argc++] = (char *)conv;
+	for ( tok = strtok( args, " " ); tok && argc < 60; tok = strtok( NULL, " " ) )
+		argv[argc++] = tok;
+	argv[argc++] = "-o";
+	argv[argc++] = (char *)config.outfile;
+	argv[argc++] = (char *)infile;
+	argv[argc] = NULL;
+
+	t0 = now();
+	if ( 0 == ( pid = fork() ) )
+	{
+		if ( 0 <= ( fd = open( "/dev/null", O_WRONLY ) ) )
+			dup2( fd, STDERR_FILENO );
+		execv( argv[0], argv );
+		_exit( 127 );
+	}
+	free( args );
+	if ( 0 > pid || pid != wait4( pid, &status, 0, &ru ) )
+		return -1.0;
+	t1 = now();
+	if ( !WIFEXITED( status ) || 0 != WEXITSTATUS( status ) )
+		return -1.0;
+	*rss_kb = ru.ru_maxrss;
+	return t1 - t0;
+}
+
+// baseline comparison: sum of log speedups, inputs
+static double speedup_log = 0.0;
+static int speedup_num = 0;
+
+static int benchFile( const char *infile )
+{
+	int i;
+	double t, best = -1.0, bbest = -1.0;
+	long rss, peak = 0;
+	long isz, osz, shapes;
+	const char *name, *p;
+	int namelen;
+
+	if ( 0 > ( isz = fsize( infile ) ) )
+	{
+		fprintf( stderr, "ERROR: stat '%s': %s\n", infile, strerror( errno ) );
+		return -1;
+	}
+	for ( i = 0; i < config.runs; ++i )
+	{
+		if ( config.base )
+		{
+			if ( 0 > ( t = runOnce( config.base, infile, &rss ) ) )
+			{
+				fprintf( stderr, "ERROR: running '%s' on '%s' failed\n", config.base, infile );
+				return -1;
+			}
+			if ( 0 > bbest || t < bbest )
+				bbest = t;
+		}
+		if ( 0 > ( t = runOnce( config.conv, infile, &rss ) ) )
+		{
+			fprintf( stderr, "ERROR: running '%s' on '%s' failed\n", config.conv, infile );
+			return -1;
+		}
+		if ( 0 > best || t < best )
+			best = t;
+		if ( rss > peak )
+			peak = rss;
+	}
+	osz = fsize( config.outfile );
+	shapes = countShapes( config.outfile );
+	if ( best <= 0.0 )
+		best = 1e-9;
+
+	// case name: file basename without extension
+	name = ( p = strrchr( infile, '/' ) ) ? p + 1 : infile;
+	namelen = ( p = strchr( name, '.' ) ) ? (int)( p - name ) : (int)strlen( name );
+
+	printf( "{\"case\":\"%.*s\",\"input_bytes\":%ld,\"output_bytes\":%ld,\"shapes\":%ld,"
+			"\"runs\":%d,\"wall_s\":%.6f,\"mb_s\":%.3f,\"shapes_s\":%.1f,\"peak_rss_kb\":%ld",
+			namelen, name, isz, osz, shapes, config.runs, best,
+			isz / best / 1e6, shapes / best, peak );
+	if ( config.base )
+	{
+		if ( bbest <= 0.0 )
+			bbest = 1e-9;
+		printf( ",\"base_wall_s\":%.6f,\"speedup\":%.3f", bbest, bbest / best );
+		speedup_log += log( bbest / best );
+		++speedup_num;
+	}
+	printf( "}\n" );
+	fflush( stdout );
+	return 0;
+}
+
+static int usage( const char *progname )
+{
+	fprintf( stderr, "Usage: %s [-c converter] [-b baseline] [-a args] [-o scratch] [-n runs] file...\n", progname );
+	fprintf( stderr,
+		"  -c file\n"
+		"     Converter binary to benchmark; default: %s\n"
+		"  -b file\n"
+		"     Baseline converter binary, run in turns with the one benchmarked, to\n"
+		"     report the speedup; default: none\n"
+		"  -a string\n"
+		"     Additional space separated converter arguments; default: none\n"
+		"  -o file\n"
+		"     Scratch file for converter output; default: %s\n"
+		"  -n num\n"
+		"     Number of runs per input, best time is reported; default: %d\n"
+		, config.conv, config.outfile, config.runs );
+	return 0;
+}
+
+int main( int argc, char **argv )
+{
+	int opt, res = 0;
+
+	while ( -1 != ( opt = getopt( argc, argv, "a:b:c:ho:n:" ) ) )
+	{
+		switch ( opt )
+		{
+		case 'a':	config.conv_args = optarg;	break;
+		case 'b':	config.base = optarg;		break;
+		case 'c':	config.conv = optarg;		break;
+		case 'o':	config.outfile = optarg;	break;
+		case 'n':
+			if ( 1 > ( config.runs = atoi( optarg ) ) )
+				config.runs = 1;
+			break;
+		case 'h':
+			usage( argv[0] );
+			exit( EXIT_SUCCESS );
+		default:
+			usage( argv[0] );
+			exit( EXIT_FAILURE );
+		}
+	}
+	for ( ; optind < argc; ++optind )
+		if ( 0 != benchFile( argv[optind] ) )
+			res = 1;
+	if ( speedup_num )
+		fprintf( stderr, "speedup over %s: %.3fx (geometric mean of %d inputs)\n",
+				config.base, exp( speedup_log / speedup_num ), speedup_num );
+	unlink( config.outfile );
+	exit( res ? EXIT_FAILURE : EXIT_SUCCESS );
+}
+
+/* EOF */
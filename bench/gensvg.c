@@ -0,0 +1,455 @@
+/*
+ * Deterministic synthetic SVG generator for benchmarking svg2ass.
+ *
+ * Project: svg2ass
+ *    File: bench/gensvg.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/************************************************************
+ *	Pseudo random numbers (xorshift32), reproducible across
+ *	platforms and libc implementations.
+ */
+
+static unsigned rng_state = 2463534242U;
+
+static unsigned rnd( void )
+{
+	unsigned x = rng_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return rng_state = x;
+}
+
+// random number in [lo,hi), one fractional digit
+static double rndf( double lo, double hi )
+{
+	return lo + (double)( rnd() % (unsigned)( ( hi - lo ) * 10 ) ) / 10.0;
+}
+
+static const char *rndcol( void )
+{
+	static const char *named[] = {
+		"red", "green", "blue", "navy", "teal", "olive", "maroon",
+		"orange", "purple", "silver", "gold", "black", "white",
+	};
+	static char buf[8];
+	if ( rnd() % 3 )
+	{
+		sprintf( buf, "#%06x", rnd() & 0xFFFFFF );
+		return buf;
+	}
+	return named[rnd() % ( sizeof named / sizeof *named )];
+}
+
+/*
+ * Print a random number preceded by a separator. Values are drawn in
+ * strict sequence (argument evaluation order is unspecified in C!),
+ * keeping the output identical across compilers.
+ */
+static void num( const char *sep, double lo, double hi )
+{
+	double v = rndf( lo, hi );
+	printf( "%s%g", sep, v );
+}
+
+static void pair( const char *sep, double lo, double hi )
+{
+	num( sep, lo, hi );
+	num( ",", lo, hi );
+}
+
+static void attr( const char *name, double lo, double hi )
+{
+	printf( " %s=\"", name );
+	num( "", lo, hi );
+	printf( "\"" );
+}
+
+static void colattr( const char *name )
+{
+	printf( " %s=\"%s\"", name, rndcol() );
+}
+
+
+/************************************************************
+ *	Document generators
+ */
+
+static void svg_head( const char *extra )
+{
+	printf( "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+			"<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1920\" height=\"1080\"%s>\n",
+			extra ? extra : "" );
+}
+
+static void svg_tail( void )
+{
+	printf( "</svg>\n" );
+}
+
+/*
+ * One single huge path mixing all path commands.
+ */
+static void gen_path( unsigned n )
+{
+	unsigned i, fa, fs;
+
+	svg_head( NULL );
+	printf( "<path fill=\"#336699\" stroke=\"black\" stroke-width=\"1\" d=\"M 960,540" );
+	for ( i = 0; i < n; ++i )
+	{
+		switch ( rnd() % 9 )
+		{
+		case 0:
+			printf( " L" );
+			num( " ", 0, 1920 );	num( ",", 0, 1080 );
+			break;
+		case 1:
+			printf( " l" );
+			num( " ", -50, 50 );	num( " ", -50, 50 );
+			break;
+		case 2:
+			printf( " h" );
+			num( " ", -50, 50 );
+			break;
+		case 3:
+			printf( " V" );
+			num( " ", 0, 1080 );
+			break;
+		case 4:
+			printf( " c" );
+			pair( " ", -50, 50 );	pair( " ", -50, 50 );	pair( " ", -50, 50 );
+			break;
+		case 5:
+			printf( " S" );
+			num( " ", 0, 1920 );	num( " ", 0, 1080 );
+			num( " ", 0, 1920 );	num( " ", 0, 1080 );
+			break;
+		case 6:
+			printf( " q" );
+			pair( " ", -50, 50 );	pair( " ", -50, 50 );
+			break;
+		case 7:
+			printf( " T" );
+			num( " ", 0, 1920 );	num( " ", 0, 1080 );
+			break;
+		case 8:
+			printf( " a" );
+			num( " ", 5, 40 );		num( " ", 5, 40 );		num( " ", 0, 90 );
+			fa = rnd() % 2;
+			fs = rnd() % 2;
+			printf( " %u %u", fa, fs );
+			num( " ", -50, 50 );	num( " ", -50, 50 );
+			break;
+		}
+		if ( 0 == i % 8 )
+			printf( "\n" );
+	}
+	printf( " z\"/>\n" );
+	svg_tail();
+}
+
+/*
+ * Thousands of elliptical arcs, circles and ellipses.
+ */
+static void gen_arcs( unsigned n )
+{
+	unsigned i, fa, fs;
+
+	svg_head( NULL );
+	for ( i = 0; i < n; ++i )
+	{
+		switch ( rnd() % 3 )
+		{
+		case 0:
+			printf( "<path" );
+			colattr( "fill" );
+			printf( " d=\"M" );
+			num( " ", 0, 1920 );	num( " ", 0, 1080 );
+			printf( " A" );
+			num( " ", 5, 200 );		num( " ", 5, 200 );		num( " ", 0, 360 );
+			fa = rnd() % 2;
+			fs = rnd() % 2;
+			printf( " %u %u", fa, fs );
+			num( " ", 0, 1920 );	num( " ", 0, 1080 );
+			printf( " a" );
+			num( " ", 5, 50 );		num( " ", 5, 50 );
+			printf( " 0 0 1" );
+			num( " ", -40, 40 );	num( " ", -40, 40 );
+			printf( " z\"/>\n" );
+			break;
+		case 1:
+			printf( "<circle" );
+			attr( "cx", 0, 1920 );	attr( "cy", 0, 1080 );	attr( "r", 1, 100 );
+			colattr( "fill" );
+			printf( "/>\n" );
+			break;
+		case 2:
+			printf( "<ellipse" );
+			attr( "cx", 0, 1920 );	attr( "cy", 0, 1080 );
+			attr( "rx", 1, 100 );	attr( "ry", 1, 100 );
+			colattr( "fill" );
+			printf( " transform=\"rotate(" );
+			num( "", 0, 90 );
+			printf( ")\"/>\n" );
+			break;
+		}
+	}
+	svg_tail();
+}
+
+/*
+ * Deeply nested group trees with transforms on every level.
+ */
+static void gen_nested_r( unsigned depth, unsigned fanout, unsigned *budget )
+{
+	unsigned i;
+
+	for ( i = 0; i < fanout && *budget; ++i )
+	{
+		printf( "%*s<g transform=\"", (int)depth, "" );
+		switch ( rnd() % 5 )
+		{
+		case 0:
+			printf( "translate(" );
+			num( "", -20, 20 );		num( ",", -20, 20 );
+			break;
+		case 1:
+			printf( "scale(" );
+			num( "", 0.9, 1.1 );	num( " ", 0.9, 1.1 );
+			break;
+		case 2:
+			printf( "rotate(" );
+			num( "", -10, 10 );
+			break;
+		case 3:
+			printf( "skewX(" );
+			num( "", -5, 5 );
+			break;
+		case 4:
+			printf( "matrix(1 0 0 1" );
+			num( " ", -20, 20 );	num( " ", -20, 20 );
+			break;
+		}
+		printf( ")\"" );
+		colattr( "fill" );
+		printf( ">\n" );
+		if ( depth < 32 && rnd() % 4 )
+			gen_nested_r( depth + 1, fanout, budget );
+		else if ( *budget )
+		{
+			printf( "%*s<rect", (int)depth + 1, "" );
+			attr( "x", 0, 1920 );	attr( "y", 0, 1080 );
+			attr( "width", 1, 50 );	attr( "height", 1, 50 );
+			printf( "/>\n" );
+			--*budget;
+		}
+		printf( "%*s</g>\n", (int)depth, "" );
+	}
+}
+
+static void gen_nested( unsigned n )
+{
+	svg_head( NULL );
+	while ( n )
+		gen_nested_r( 1, 3, &n );
+	svg_tail();
+}
+
+/*
+ * Attribute heavy Inkscape style markup, including editor cruft.
+ */
+static void gen_inkscape( unsigned n )
+{
+	unsigned i;
+
+	svg_head( "\n   xmlns:dc=\"http://purl.org/dc/elements/1.1/\""
+			  "\n   xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\""
+			  "\n   xmlns:sodipodi=\"http://sodipodi.sourceforge.net/DTD/sodipodi-0.dtd\""
+			  "\n   xmlns:inkscape=\"http://www.inkscape.org/namespaces/inkscape\""
+			  "\n   id=\"svg2\" version=\"1.1\" inkscape:version=\"1.0.2\""
+			  "\n   sodipodi:docname=\"drawing.svg\"" );
+	printf( "  <sodipodi:namedview id=\"base\" pagecolor=\"#ffffff\" bordercolor=\"#666666\"\n"
+			"     borderopacity=\"1.0\" inkscape:pageopacity=\"0.0\" inkscape:pageshadow=\"2\"\n"
+			"     inkscape:zoom=\"0.35\" inkscape:cx=\"960\" inkscape:cy=\"540\"\n"
+			"     inkscape:document-units=\"px\" inkscape:current-layer=\"layer1\"\n"
+			"     showgrid=\"false\" inkscape:window-width=\"1920\" inkscape:window-height=\"1016\"/>\n" );
+	printf( "  <metadata id=\"metadata7\">\n    <rdf:RDF>\n      <cc:Work rdf:about=\"\">\n"
+			"        <dc:format>image/svg+xml</dc:format>\n"
+			"        <dc:type rdf:resource=\"http://purl.org/dc/dcmitype/StillImage\"/>\n"
+			"        <dc:title>Benchmark</dc:title>\n      </cc:Work>\n    </rdf:RDF>\n  </metadata>\n" );
+	printf( "  <g inkscape:label=\"Layer 1\" inkscape:groupmode=\"layer\" id=\"layer1\">\n" );
+	for ( i = 0; i < n; ++i )
+	{
+		printf( "    <path\n       style=\"opacity:1;fill:%s;fill-opacity:", rndcol() );
+		num( "", 0, 1 );
+		printf( ";fill-rule:nonzero;stroke:%s;stroke-width:", rndcol() );
+		num( "", 0, 5 );
+		printf( ";stroke-linecap:butt;stroke-linejoin:miter;stroke-miterlimit:4;"
+				"stroke-dasharray:none;stroke-dashoffset:0;stroke-opacity:1;paint-order:normal\"\n"
+				"       d=\"m" );
+		pair( " ", 0, 1000 );
+		printf( " c" );
+		pair( " ", -30, 30 );	pair( " ", -30, 30 );	pair( " ", -30, 30 );
+		printf( " l" );
+		pair( " ", -30, 30 );
+		printf( " z\"\n"
+				"       id=\"path%u\"\n"
+				"       inkscape:connector-curvature=\"0\"\n"
+				"       sodipodi:nodetypes=\"ccc\" />\n",
+				1000 + i );
+	}
+	printf( "  </g>\n" );
+	svg_tail();
+}
+
+/*
+ * Many small polygons and polylines.
+ */
+static void gen_polygons( unsigned n )
+{
+	unsigned i, k, nv;
+	double x, y;
+
+	svg_head( NULL );
+	for ( i = 0; i < n; ++i )
+	{
+		x = rndf( 0, 1920 );
+		y = rndf( 0, 1080 );
+		nv = 3 + rnd() % 6;
+		printf( "<%s", ( rnd() % 4 ) ? "polygon" : "polyline" );
+		colattr( "fill" );
+		printf( " points=\"" );
+		for ( k = 0; k < nv; ++k )
+		{
+			num( k ? " " : "", x - 20, x + 20 );
+			num( ",", y - 20, y + 20 );
+		}
+		printf( "\"/>\n" );
+	}
+	svg_tail();
+}
+
+/*
+ * Large inline style blocks, many unknown declarations.
+ */
+static void gen_styles( unsigned n )
+{
+	unsigned i, k;
+
+	svg_head( NULL );
+	for ( i = 0; i < n; ++i )
+	{
+		printf( "<rect" );
+		attr( "x", 0, 1920 );		attr( "y", 0, 1080 );
+		attr( "width", 1, 100 );	attr( "height", 1, 100 );
+		printf( " style=\"" );
+		for ( k = 0; k < 4; ++k )
+		{
+			printf( "font-family:'Bitstream Vera Sans';font-size:" );
+			num( "", 8, 40 );
+			printf( "px;-inkscape-font-specification:Sans;text-anchor:start;"
+					"display:inline;overflow:visible;visibility:visible;"
+					"marker:none;enable-background:accumulate;" );
+		}
+		printf( "fill:%s;fill-opacity:", rndcol() );
+		num( "", 0, 1 );
+		printf( ";stroke:%s;stroke-opacity:", rndcol() );
+		num( "", 0, 1 );
+		printf( ";stroke-width:" );
+		num( "", 0, 4 );
+		printf( "\"/>\n" );
+	}
+	svg_tail();
+}
+
+
+/************************************************************
+ *	Main program stuff
+ */
+
+static const struct {
+	const char *name;
+	void (*gen)( unsigned n );
+	unsigned dflt_n;
+} generators[] = {
+	{ "path",		gen_path,		20000 },
+	{ "arcs",		gen_arcs,		5000 },
+	{ "nested",		gen_nested,		20000 },
+	{ "inkscape",	gen_inkscape,	10000 },
+	{ "polygons",	gen_polygons,	20000 },
+	{ "styles",		gen_styles,		10000 },
+	{ NULL, NULL, 0 },
+};
+
+static int usage( const char *progname )
+{
+	int i;
+
+	fprintf( stderr, "Usage: %s [-n count] [-r seed] kind\n", progname );
+	fprintf( stderr,
+		"Write a deterministic synthetic SVG document to stdout.\n"
+		"  -n num\n"
+		"     Number of generated primitives; default depends on kind.\n"
+		"  -r num\n"
+		"     Seed for the pseudo random number generator; default: 1\n"
+		"Available kinds:\n" );
+	for ( i = 0; generators[i].name; ++i )
+		fprintf( stderr, "  %-10s (default count %u)\n", generators[i].name, generators[i].dflt_n );
+	return 0;
+}
+
+int main( int argc, char **argv )
+{
+	int i, opt;
+	unsigned n = 0;
+
+	while ( -1 != ( opt = getopt( argc, argv, "hn:r:" ) ) )
+	{
+		switch ( opt )
+		{
+		case 'n':
+			n = strtoul( optarg, NULL, 0 );
+			break;
+		case 'r':
+			rng_state ^= strtoul( optarg, NULL, 0 ) * 2654435761U;
+			if ( !rng_state )
+				rng_state = 1;
+			break;
+		case 'h':
+			usage( argv[0] );
+			exit( EXIT_SUCCESS );
+		default:
+			usage( argv[0] );
+			exit( EXIT_FAILURE );
+		}
+	}
+	if ( optind >= argc )
+	{
+		usage( argv[0] );
+		exit( EXIT_FAILURE );
+	}
+	for ( i = 0; generators[i].name; ++i )
+	{
+		if ( 0 == strcmp( generators[i].name, argv[optind] ) )
+		{
+			generators[i].gen( n ? n : generators[i].dflt_n );
+			exit( ferror( stdout ) ? EXIT_FAILURE : EXIT_SUCCESS );
+		}
+	}
+	fprintf( stderr, "ERROR: unknown kind '%s'\n", argv[optind] );
+	exit( EXIT_FAILURE );
+}
+
+/* EOF */
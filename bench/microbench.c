@@ -0,0 +1,444 @@
+/*
+ * Micro-benchmark harness for individual svg2ass kernels.
+ *
+ * Project: svg2ass
+ *    File: bench/microbench.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * The converter translation unit is included verbatim, so the static
+ * kernels can be driven directly. Each kernel processes a fixed,
+ * pseudo randomly generated input set per sample; after warm-up the
+ * per operation timings of all samples are reported as minimum,
+ * median and percentiles.
+ */
+
+#define main svg2ass_main
+#include "../main.c"
+#undef main
+
+#include <time.h>
+
+
+/************************************************************
+ *	Repeatable input sets
+ */
+
+#define NSET	256
+
+static unsigned rng_state = 2463534242U;
+
+static unsigned rnd( void )
+{
+	unsigned x = rng_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return rng_state = x;
+}
+
+static double rndf( double lo, double hi )
+{
+	return lo + ( hi - lo ) * ( rnd() / 4294967296.0 );
+}
+
+static struct {
+	double num[NSET];
+	vec_t vec[NSET];
+	mtx_t mtx[NSET];
+	char path[NSET][160];
+	struct { vec_t v0, r, v; double phi; int fa, fs; } arc[NSET];
+	char trf[NSET][80];
+	char col[NSET][16];
+	nxmlAttrib_t att[NSET][8];
+	nxmlNode_t node[NSET];
+	char style[NSET][400];
+	char *doc;
+	size_t docsz;
+	char *work;
+} in;
+
+static void initInput( void )
+{
+	int i, k;
+	size_t n, cap;
+	static const char *named[] = {
+		"red", "navy", "teal", "yellowgreen", "aliceblue", "darkslategrey",
+		"whitesmoke", "black", "cornflowerblue", "tomato",
+	};
+	static const char *trf_fmt[] = {
+		"translate(%.1f,%.1f)", "scale(%.2f %.2f)", "rotate(%.1f)",
+		"rotate(%.1f %.1f %.1f)", "skewX(%.1f)", "matrix(1 0 0 1 %.1f %.1f)",
+		"translate(%.1f %.1f) scale(%.2f)",
+	};
+	static const char *elem =
+		"<path style=\"fill:#336699;fill-opacity:0.5;stroke:#000000;stroke-width:1\""
+		" d=\"m 10,10 c 5,5 10,0 15,5 z\" id=\"path%d\" inkscape:connector-curvature=\"0\"/>\n"
+		"<g transform=\"translate(1,2)\"><rect x=\"1\" y=\"2\" width=\"3\" height=\"4\"/></g>\n"
+		"<!-- comment --><text>some text</text>\n";
+
+	for ( i = 0; i < NSET; ++i )
+	{
+		switch ( i % 4 )
+		{
+		case 0:	in.num[i] = rndf( -2000, 2000 ); break;
+		case 1:	in.num[i] = rndf( -1, 1 ); break;
+		case 2:	in.num[i] = (int)rndf( -2000, 2000 ); break;
+		case 3:	in.num[i] = rndf( -1e6, 1e6 ); break;
+		}
+		in.vec[i] = VEC( rndf( 0, 1920 ), rndf( 0, 1080 ) );
+		in.mtx[i] = MTX( rndf( -2, 2 ), rndf( -2, 2 ), rndf( -100, 100 ),
+						 rndf( -2, 2 ), rndf( -2, 2 ), rndf( -100, 100 ) );
+
+		snprintf( in.path[i], sizeof in.path[i],
+				"M %.1f,%.1f L %.1f %.1f c 1,2 3,4 5,6 s 1 2 3 4 q 1,1 2,2 t 3 3 h 5 v -5 H 0 V 0 z",
+				rndf( 0, 100 ), rndf( 0, 100 ), rndf( 0, 100 ), rndf( 0, 100 ) );
+
+		in.arc[i].v0 = VEC( rndf( 0, 100 ), rndf( 0, 100 ) );
+		in.arc[i].v = VEC( rndf( 0, 100 ), rndf( 0, 100 ) );
+		in.arc[i].r = VEC( rndf( 5, 80 ), rndf( 5, 80 ) );
+		in.arc[i].phi = rndf( 0, 360 );
+		in.arc[i].fa = rnd() % 2;
+		in.arc[i].fs = rnd() % 2;
+
+		k = i % ( sizeof trf_fmt / sizeof *trf_fmt );
+		snprintf( in.trf[i], sizeof in.trf[i], trf_fmt[k],
+				rndf( -50, 50 ), rndf( 0.5, 2 ), rndf( 0.5, 2 ) );
+
+		if ( i % 2 )
+			snprintf( in.col[i], sizeof in.col[i], "#%06x", rnd() & 0xFFFFFF );
+		else
+			snprintf( in.col[i], sizeof in.col[i], "%s", named[i / 2 % 10] );
+
+		snprintf( in.style[i], sizeof in.style[i],
+				"opacity:1;fill:%s;fill-opacity:%.2f;fill-rule:nonzero;stroke:%s;"
+				"stroke-width:%.1f;stroke-linecap:butt;stroke-linejoin:miter;"
+				"stroke-miterlimit:4;stroke-dasharray:none;stroke-opacity:1",
+				in.col[i], rndf( 0, 1 ), in.col[( i + 1 ) % NSET], rndf( 0, 5 ) );
+		in.att[i][0] = (nxmlAttrib_t){ "id", "path1" };
+		in.att[i][1] = (nxmlAttrib_t){ "d", in.path[i] };
+		in.att[i][2] = (nxmlAttrib_t){ "fill", ( i % 3 ) ? in.col[i] : "none" };
+		in.att[i][3] = (nxmlAttrib_t){ "style", in.style[i] };
+		in.node[i].type = NXML_TYPE_SELF;
+		in.node[i].name = "path";
+		in.node[i].att = in.att[i];
+		in.node[i].att_num = 4;
+		in.node[i].att_sz = 8;
+	}
+
+	// tokenizer input: ~1MB of Inkscape style markup
+	cap = 1 << 20;
+	in.doc = malloc( cap + 512 );
+	in.work = malloc( cap + 512 );
+	if ( !in.doc || !in.work )
+		err( ELVL_FATAL, 0, "malloc: %s", strerror( errno ) );
+	n = sprintf( in.doc, "<?xml version=\"1.0\"?>\n<svg>\n" );
+	for ( i = 0; n < cap; ++i )
+		n += sprintf( in.doc + n, elem, i );
+	n += sprintf( in.doc + n, "</svg>\n" );
+	in.docsz = n + 1;
+}
+
+
+/************************************************************
+ *	Kernels; each processes one complete input set and returns
+ *	the number of operations performed.
+ */
+
+static volatile double sink;
+
+static long k_ftoa( void )
+{
+	int i;
+	char buf[64];
+	for ( i = 0; i < NSET; ++i )
+		sink += *ftoa( buf, config.ass_fprec, in.num[i] );
+	return NSET;
+}
+
+static long k_emitf( void )
+{
+	int i;
+	ctx_t ctx;
+	memset( &ctx, 0, sizeof ctx );
+	for ( i = 0; i < NSET; ++i )
+	{
+		ctx.ctm = in.mtx[i];
+		ctx.ctm_kind = mtx_kind( ctx.ctm );
+		emitf( &ctx, "l %v %f ", in.vec[i], in.num[i] );
+	}
+	return NSET;
+}
+
+static long k_ass_path( void )
+{
+	int i;
+	ctx_t ctx;
+	memset( &ctx, 0, sizeof ctx );
+	ctx.ctm = MTX_UNI;
+	for ( i = 0; i < NSET; ++i )
+	{
+		shape.num = 0;
+		ass_path( in.path[i] );
+		fmtShape( &ctx, &shape );
+	}
+	return NSET;
+}
+
+static long k_ass_arc( void )
+{
+	int i;
+	ctx_t ctx;
+	memset( &ctx, 0, sizeof ctx );
+	ctx.ctm = MTX_UNI;
+	for ( i = 0; i < NSET; ++i )
+	{
+		shape.num = 0;
+		ass_arc( in.arc[i].v0, in.arc[i].r, in.arc[i].phi,
+				in.arc[i].fa, in.arc[i].fs, in.arc[i].v );
+		fmtShape( &ctx, &shape );
+	}
+	return NSET;
+}
+
+static long k_parseTransform( void )
+{
+	int i;
+	ctx_t ctx;
+	for ( i = 0; i < NSET; ++i )
+	{
+		ctx.ctm = MTX_UNI;
+		parseTransform( &ctx, in.trf[i] );
+		sink += ctx.ctm.e;
+	}
+	return NSET;
+}
+
+static long k_transformMatrix( void )
+{
+	int i;
+	for ( i = 0; i < NSET; ++i )
+		sink += transformMatrix( in.trf[i] ).e;
+	return NSET;
+}
+
+static long k_parseStyles( void )
+{
+	int i;
+	ctx_t ctx;
+	memset( &ctx, 0, sizeof ctx );
+	for ( i = 0; i < NSET; ++i )
+	{
+		parseStyles( &ctx, &in.node[i] );
+		sink += ctx.s_width;
+	}
+	return NSET;
+}
+
+static long k_convColorBGR( void )
+{
+	int i;
+	for ( i = 0; i < NSET; ++i )
+		sink += convColorBGR( in.col[i] );
+	return NSET;
+}
+
+static int nullCb( nxmlEvent_t evt, const nxmlNode_t *node, void *usr )
+{
+	(void)evt;
+	(void)usr;
+	sink += node->att_num;
+	return 0;
+}
+
+static long k_nxmlParse( void )
+{
+	memcpy( in.work, in.doc, in.docsz );
+	nxmlParse( in.work, nullCb, NULL );
+	return (long)in.docsz;	// ops are bytes
+}
+
+static arena_t dom_arena;
+
+static long k_nxmlDomBuild( void )
+{
+	nxmlOpt_t opt = { &dom_arena, NXML_IGN_TEXT };
+	memcpy( in.work, in.doc, in.docsz );
+	arenaReset( &dom_arena );
+	sink += nxmlDomBuild( in.work, &opt )->nnode;
+	return (long)in.docsz;
+}
+
+static long k_nxmlDomWalk( void )
+{
+	static arena_t a;
+	static char *buf;
+	static nxmlDom_t *dom;
+
+	if ( !dom )
+	{	// built once, walked repeatedly
+		nxmlOpt_t opt = { &a, NXML_IGN_TEXT };
+		if ( NULL == ( buf = arenaAlloc( &a, in.docsz ) ) )
+			return 0;
+		memcpy( buf, in.doc, in.docsz );
+		dom = nxmlDomBuild( buf, &opt );
+	}
+	nxmlDomWalk( dom, 0, nullCb, NULL );
+	return (long)in.docsz;
+}
+
+static long k_vect( void )
+{
+	int i;
+	vec_t v = VEC_ZERO;
+	mtx_t m;
+	for ( i = 0; i < NSET; ++i )
+	{
+		v = vec_add( v, vec_mmul( in.mtx[i], in.vec[i] ) );
+		v = vec_scal( vec_sub( v, in.vec[i] ), 0.5 );
+		m = mtx_mmul( in.mtx[i], in.mtx[( i + 1 ) % NSET] );
+		sink += vec_ang( in.vec[i], in.vec[( i + 1 ) % NSET] );
+		sink += vec_abs( vec_norm( in.vec[i], i & 1 ) );
+		sink += vec_eq( v, in.vec[i], 0.5 ) + m.a;
+	}
+	sink += v.x;
+	return NSET;
+}
+
+static const struct {
+	const char *name;
+	long (*fn)( void );
+	const char *unit;
+} kernels[] = {
+	{ "ftoa",			k_ftoa,				"call" },
+	{ "emitf",			k_emitf,			"call" },
+	{ "ass_path",		k_ass_path,			"path" },
+	{ "ass_arc",		k_ass_arc,			"arc" },
+	{ "parseTransform",	k_parseTransform,	"attr" },
+	{ "transformMatrix",	k_transformMatrix,	"attr" },
+	{ "parseStyles",	k_parseStyles,		"node" },
+	{ "convColorBGR",	k_convColorBGR,		"color" },
+	{ "nxmlParse",		k_nxmlParse,		"byte" },
+	{ "nxmlDomBuild",	k_nxmlDomBuild,		"byte" },
+	{ "nxmlDomWalk",	k_nxmlDomWalk,		"byte" },
+	{ "vect",			k_vect,				"iter" },
+	{ NULL, NULL, NULL },
+};
+
+
+/************************************************************
+ *	Harness
+ */
+
+static double now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int dblcmp( const void *a, const void *b )
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return ( x > y ) - ( x < y );
+}
+
+static double pct( const double *sorted, int n, double p )
+{
+	int i = (int)( p / 100.0 * ( n - 1 ) + 0.5 );
+	return sorted[i < n ? i : n - 1];
+}
+
+static int benchUsage( const char *progname )
+{
+	int i;
+
+	fprintf( stderr, "Usage: %s [-j] [-n samples] [-w warmup] [kernel...]\n", progname );
+	fprintf( stderr,
+		"Time individual converter kernels, report ns per operation.\n"
+		"  -j Print one JSON object per kernel instead of a table.\n"
+		"  -n num\n"
+		"     Number of timed samples per kernel; default: 200\n"
+		"  -w num\n"
+		"     Number of untimed warm-up samples per kernel; default: 20\n"
+		"Available kernels:\n" );
+	for ( i = 0; kernels[i].name; ++i )
+		fprintf( stderr, "  %s\n", kernels[i].name );
+	return 0;
+}
+
+int main( int argc, char **argv )
+{
+	int i, k, opt, a;
+	int json = 0, nsamp = 200, nwarm = 20;
+	long ops = 0;
+	double t0, *samp;
+
+	while ( -1 != ( opt = getopt( argc, argv, "hjn:w:" ) ) )
+	{
+		switch ( opt )
+		{
+		case 'j':	json = 1;	break;
+		case 'n':	nsamp = atoi( optarg );	break;
+		case 'w':	nwarm = atoi( optarg );	break;
+		case 'h':
+			benchUsage( argv[0] );
+			exit( EXIT_SUCCESS );
+		default:
+			benchUsage( argv[0] );
+			exit( EXIT_FAILURE );
+		}
+	}
+	if ( 1 > nsamp )
+		nsamp = 1;
+	if ( NULL == ( samp = malloc( nsamp * sizeof *samp ) ) )
+		err( ELVL_FATAL, 0, "malloc: %s", strerror( errno ) );
+	// kernel output is discarded
+	if ( NULL == ( config.of = fopen( "/dev/null", "w" ) ) )
+		err( ELVL_FATAL, 0, "fopen '/dev/null': %s", strerror( errno ) );
+	initInput();
+
+	if ( !json )
+		printf( "%-16s %8s %12s %12s %12s %12s %12s\n",
+				"kernel", "unit", "min ns", "median ns", "p90 ns", "p99 ns", "ops/sample" );
+	for ( k = 0; kernels[k].name; ++k )
+	{
+		if ( optind < argc )
+		{	// run selected kernels only
+			for ( a = optind; a < argc; ++a )
+				if ( 0 == strcmp( argv[a], kernels[k].name ) )
+					break;
+			if ( a == argc )
+				continue;
+		}
+		for ( i = 0; i < nwarm; ++i )
+			kernels[k].fn();
+		for ( i = 0; i < nsamp; ++i )
+		{
+			t0 = now();
+			ops = kernels[k].fn();
+			samp[i] = ( now() - t0 ) * 1e9 / ops;
+		}
+		qsort( samp, nsamp, sizeof *samp, dblcmp );
+		if ( json )
+			printf( "{\"kernel\":\"%s\",\"unit\":\"%s\",\"samples\":%d,\"ops\":%ld,"
+					"\"min_ns\":%.3f,\"median_ns\":%.3f,\"p90_ns\":%.3f,\"p99_ns\":%.3f}\n",
+					kernels[k].name, kernels[k].unit, nsamp, ops,
+					samp[0], pct( samp, nsamp, 50 ), pct( samp, nsamp, 90 ),
+					pct( samp, nsamp, 99 ) );
+		else
+			printf( "%-16s %8s %12.2f %12.2f %12.2f %12.2f %12ld\n",
+					kernels[k].name, kernels[k].unit,
+					samp[0], pct( samp, nsamp, 50 ), pct( samp, nsamp, 90 ),
+					pct( samp, nsamp, 99 ), ops );
+		fflush( stdout );
+	}
+	free( samp );
+	free( in.doc );
+	free( in.work );
+	exit( EXIT_SUCCESS );
+}
+
+/* EOF */
@@ -7,8 +7,18 @@
  * See LICENSE file for more details.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "colors.h"
+
+#ifndef M_PI
+	#define M_PI 3.14159265358979323846
+#endif
 
 #define RGB2BGR(R,G,B) ((unsigned)(B)<<16 | (G)<<8 | (R))
 
@@ -167,24 +177,319 @@ static struct {
 	{ NULL, 0 },
 };
 
-unsigned convColorBGR( const char *s )
+/*
+ * Named colors are looked up through a perfect hash: a seeded FNV-1a
+ * hash over the case folded name maps every table entry to a distinct
+ * slot, so a lookup costs one hash and one string compare. The slot
+ * table below is generated by building this file with -DCOLORS_GENTAB
+ * and running the result; regenerate it whenever cols[] changes.
+ */
+#define NAMEHASH_BITS	10
+#define NAMEHASH_SEED	49679u
+
+static inline unsigned nameHash( const char *s, size_t len, unsigned seed )
 {
-	unsigned bgr = 0;
-	if ( '#' == *s )
+	unsigned h = 2166136261u ^ seed;
+	while ( len-- )
+		h = ( h ^ ( (unsigned char)*s++ | 0x20 ) ) * 16777619u;
+	return h >> ( 32 - NAMEHASH_BITS );
+}
+
+#ifndef COLORS_GENTAB
+static const unsigned char nameslot[1 << NAMEHASH_BITS] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  32,  65,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0, 130,   0,   0,   0,  46,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0, 101,   0,   0,  45,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  19,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  26,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0, 116,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  3,   0,  11,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  70, 113,   0,
+	  0,   0,   0,   0,   0,   0, 110,  23,   0,  34,   0,   0,   0,   0,   0,   0,
+	  0, 139,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,  21,   0,   0,   0, 142,   0,   0,   0,   0,   0,   0,
+	  0,   0,  91,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   6,
+	  0,   0,   0,  63, 122,   0,   0,   0, 140,   0,   0,   0,   0,   0,   0, 103,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,  83,   0, 109,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0, 131,   0,   0,   0,   0,   0,   0,   0,  37, 114,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, 144,   0,   0,
+	  0,  20,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  38,   0,
+	  0,  61,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  86,   0,   0, 137,
+	 58,   0,   0, 135,  35,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,  47,   0,   0,   0,   0,   0,  89,   0,   0,   0, 106,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,  16,  67,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,  81,  93,   0,   0,   0,   0,   0,  17,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  74,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  77,   0,   0, 126,
+	  0,   0,   9,   4,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  72,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, 145,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,  48, 128,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0, 138,   0,   0,   0,   0,   0,   0,   0, 136,   0,   0,   0,
+	  0, 125,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0, 112,   0,   0,   0,   0,   0,   0,   0,   5,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0, 100,   0,  62,   0,   1,   0,   0,   0,   0,   0,
+	  0, 119,   0,   0,   0,   0,   0, 118,  94,   0,   0, 127,   0,  76,  42,   0,
+	  0,   0,   0,  88,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  36,
+	  0,   0, 108, 104,  90,   0,   0,   0,   8,   0,  96,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,  14,   0,   7,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0, 129,   0, 141,   0,   0,   0,  71,
+	  0,   0,   0,   0,  31,   0,   0,  73,   0,  33,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,  56,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  75,
+	  0,   0,   0,   0,   0, 102,   0,  27,   0,   0,   0,   0,  22,   0,   0,   0,
+	  0,   0,   0,   0,  60,   0,   0,   0,   0,  69,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0, 146,  25,   0,   0,   0,   0,   0,  64,   0,   0,   0,
+	  0,   0,   0,   0,   0,  79,   0,   0,   0,  43,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,  95,   0,   0,   0,   0,   0,   0,   0,   0,  98,
+	  0,   0,   0,   0,   0,  80,   0,   0,   0,  44,   0,  18,   0,   0,  87,   0,
+	  0,   0,   0,   0,   0,   0,   0, 111,   0,   0,   0,   0,   0,  85,  82,   0,
+	115,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  30,  53,   0,   0,   0,
+	  0,   0,   0,  78,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,  15,   0,   0,   0,   0,   0,  92,   0,   0,   0,   0,   0,   0,   0, 120,
+	  0,   0,   2,   0,   0,  13,   0,   0,   0,   0,   0, 124,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,  59, 133, 147,   0,   0,   0,   0,   0,   0,   0,  29,
+	  0,   0,   0, 117,   0,   0,   0,   0, 123,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,  39,   0,   0,   0,   0, 132,   0,  49,  51,  12,   0,   0,   0,   0,
+	 40,   0,   0,   0,   0,   0,   0,  68,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0, 143,   0,   0,   0,  41,   0,   0,  54,   0, 107,  28,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,  50,   0,   0,   0,   0,   0,   0,
+	  0,  24,  99,   0,   0,   0,   0,   0, 134,  55,   0,   0,   0,   0,  84,   0,
+	  0,   0,   0, 121,  57,   0,   0,   0,   0,   0,  52,   0,   0,   0,   0, 105,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,  97,  66,   0,  10,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+static int namedColor( const char *s, size_t len, unsigned *bgr )
+{
+	unsigned i = nameslot[nameHash( s, len, NAMEHASH_SEED )];
+
+	if ( 0 == i-- || 0 != strncasecmp( cols[i].s, s, len ) || cols[i].s[len] )
+		return -1;
+	*bgr = cols[i].bgr;
+	return 0;
+}
+
+static inline int hexval( int c )
+{
+	if ( c >= '0' && c <= '9' )
+		return c - '0';
+	c |= 0x20;
+	if ( c >= 'a' && c <= 'f' )
+		return c - 'a' + 10;
+	return -1;
+}
+
+static inline const char *skipws( const char *s )
+{
+	while ( isspace( (unsigned char)*s ) )
+		++s;
+	return s;
+}
+
+static inline double clamp( double d, double lo, double hi )
+{
+	return d < lo ? lo : d > hi ? hi : d;
+}
+
+/*
+ * Parse one functional notation argument, optionally followed by a
+ * unit; the separating comma or slash, if any, is consumed. Returns
+ * the unit character: '%', 'd' for angles, ' ' for plain numbers,
+ * or 0 on error.
+ */
+static int funcArg( const char **ps, double *d )
+{
+	const char *s = skipws( *ps );
+	char *e;
+	int unit = ' ';
+
+	*d = strtod( s, &e );
+	if ( e == s )
+		return 0;
+	s = e;
+	if ( '%' == *s )
+	{
+		unit = '%';
+		++s;
+	}
+	else if ( isalpha( (unsigned char)*s ) )
+	{
+		// angle units, normalized to degrees
+		unit = 'd';
+		if ( 0 == strncasecmp( s, "grad", 4 ) )
+			*d *= 0.9;
+		else if ( 0 == strncasecmp( s, "rad", 3 ) )
+			*d *= 180.0 / M_PI;
+		else if ( 0 == strncasecmp( s, "turn", 4 ) )
+			*d *= 360.0;
+		else if ( 0 != strncasecmp( s, "deg", 3 ) )
+			return 0;
+		while ( isalpha( (unsigned char)*s ) )
+			++s;
+	}
+	s = skipws( s );
+	if ( ',' == *s || '/' == *s )
+		s = skipws( s + 1 );
+	*ps = s;
+	return unit;
+}
+
+static double hue2rgb( double m1, double m2, double h )
+{
+	if ( h < 0.0 )
+		h += 1.0;
+	else if ( h > 1.0 )
+		h -= 1.0;
+	if ( h * 6.0 < 1.0 )
+		return m1 + ( m2 - m1 ) * h * 6.0;
+	if ( h * 2.0 < 1.0 )
+		return m2;
+	if ( h * 3.0 < 2.0 )
+		return m1 + ( m2 - m1 ) * ( 2.0 / 3.0 - h ) * 6.0;
+	return m1;
+}
+
+/*
+ * rgb(), rgba(), hsl() and hsla() in both comma and space separated
+ * syntax, with optional alpha; s points past the opening parenthesis.
+ */
+static int funcColor( const char *s, int hsl, unsigned *bgr, unsigned *alpha )
+{
+	double c[4] = { 0.0, 0.0, 0.0, 1.0 };
+	int i, u;
+
+	for ( i = 0; i < 4 && ')' != *( s = skipws( s ) ); ++i )
+	{
+		if ( 0 == ( u = funcArg( &s, &c[i] ) ) )
+			return -1;
+		if ( 3 == i )
+			c[i] = '%' == u ? c[i] / 100.0 : c[i];
+		else if ( hsl )
+			c[i] = i ? c[i] / 100.0 : c[i] / 360.0;
+		else
+			c[i] = '%' == u ? c[i] / 100.0 : c[i] / 255.0;
+	}
+	if ( i < 3 || ')' != *s )
+		return -1;
+	for ( i = 1; i < 4; ++i )
+		c[i] = clamp( c[i], 0.0, 1.0 );
+	if ( hsl )
 	{
-		unsigned rgb = strtoul( s + 1, NULL, 16 );
-		bgr = (rgb & 0xFF) << 16 | (rgb & 0xFF00) | (rgb & 0xFF0000 ) >> 16;
+		double h = c[0] - floor( c[0] ), sat = c[1], l = c[2];
+		double m2 = l <= 0.5 ? l * ( sat + 1.0 ) : l + sat - l * sat;
+		double m1 = l * 2.0 - m2;
+		c[0] = hue2rgb( m1, m2, h + 1.0 / 3.0 );
+		c[1] = hue2rgb( m1, m2, h );
+		c[2] = hue2rgb( m1, m2, h - 1.0 / 3.0 );
 	}
 	else
+		c[0] = clamp( c[0], 0.0, 1.0 );
+	*bgr = RGB2BGR( (unsigned)lround( c[0] * 255.0 ),
+					(unsigned)lround( c[1] * 255.0 ),
+					(unsigned)lround( c[2] * 255.0 ) );
+	*alpha = 255 - (unsigned)lround( c[3] * 255.0 );
+	return 0;
+}
+
+int parseColor( const char *s, unsigned *bgr, unsigned *alpha )
+{
+	size_t len;
+	unsigned v[8];
+	int i;
+
+	s = skipws( s );
+	for ( len = 0; s[len] && !isspace( (unsigned char)s[len] ) && '(' != s[len]; ++len )
+		;
+	*alpha = 0;
+	if ( '#' == *s )
 	{
-		for ( int i = 0; cols[i].s; ++i )
-			if ( 0 == strcasecmp( cols[i].s, s ) )
-			{
-				bgr = cols[i].bgr;
-				break;
-			}
+		for ( i = 0; i < 8 && 0 <= (int)( v[i] = hexval( s[i + 1] ) ); ++i )
+			;
+		if ( (size_t)i + 1 != len )
+			return -1;
+		switch ( i )
+		{
+		case 4:
+			*alpha = 255 - v[3] * 17;
+			// fall through
+		case 3:
+			*bgr = RGB2BGR( v[0] * 17, v[1] * 17, v[2] * 17 );
+			return 0;
+		case 8:
+			*alpha = 255 - ( v[6] << 4 | v[7] );
+			// fall through
+		case 6:
+			*bgr = RGB2BGR( v[0] << 4 | v[1], v[2] << 4 | v[3], v[4] << 4 | v[5] );
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	if ( '(' == *skipws( s + len ) )
+	{
+		const char *p = skipws( s + len ) + 1;
+		if ( ( 3 == len || 4 == len ) && 0 == strncasecmp( s, "rgba", len ) )
+			return funcColor( p, 0, bgr, alpha );
+		if ( ( 3 == len || 4 == len ) && 0 == strncasecmp( s, "hsla", len ) )
+			return funcColor( p, 1, bgr, alpha );
+		return -1;
 	}
+	if ( *skipws( s + len ) )
+		return -1;
+	if ( 12 == len && 0 == strncasecmp( s, "currentColor", len ) )
+		return 1;
+	if ( 11 == len && 0 == strncasecmp( s, "transparent", len ) )
+	{
+		*bgr = 0;
+		*alpha = 255;
+		return 0;
+	}
+	return namedColor( s, len, bgr );
+}
+
+unsigned convColorBGR( const char *s )
+{
+	unsigned bgr = 0, alpha;
+	if ( 0 != parseColor( s, &bgr, &alpha ) )
+		bgr = 0;
 	return bgr;
 }
 
+#else	// COLORS_GENTAB
+
+/*
+ * Search seed for a collision free mapping and dump the slot table.
+ */
+int main( void )
+{
+	unsigned char slot[1 << NAMEHASH_BITS];
+	unsigned seed, h;
+	int i;
+
+	for ( seed = 0; seed < 0xFFFFFFFFu; ++seed )
+	{
+		memset( slot, 0, sizeof slot );
+		for ( i = 0; cols[i].s; ++i )
+		{
+			h = nameHash( cols[i].s, strlen( cols[i].s ), seed );
+			if ( slot[h] )
+				break;
+			slot[h] = i + 1;
+		}
+		if ( !cols[i].s )
+			break;
+	}
+	printf( "#define NAMEHASH_SEED\t%uu\n", seed );
+	for ( i = 0; i < 1 << NAMEHASH_BITS; ++i )
+		printf( "%s%3u,", i % 16 ? " " : i ? "\n\t" : "\t", slot[i] );
+	printf( "\n" );
+	return 0;
+}
+
+#endif	// COLORS_GENTAB
+
 /* EOF */
@@ -8,7 +8,17 @@
  */
 
 /*
- * Convert named or #rrggbb coded color to unsigned BGR (sic!)
+ * Parse CSS color value: named, #rgb, #rgba, #rrggbb, #rrggbbaa,
+ * rgb(), rgba(), hsl(), hsla() and transparent. Stores color as
+ * unsigned BGR (sic!) and alpha as ASS style transparency (0 = opaque,
+ * 255 = fully transparent). Returns 0 on success, 1 for currentColor,
+ * and -1 for invalid or unsupported values.
+ */
+int parseColor( const char *s, unsigned *bgr, unsigned *alpha );
+
+/*
+ * Convert color to unsigned BGR, ignoring alpha; invalid colors
+ * yield black.
  */
 unsigned convColorBGR( const char *s );
 
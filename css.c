@@ -0,0 +1,663 @@
+/*
+ * Minimal CSS declaration tokenizer and property table.
+ *
+ * Project: svg2ass
+ *    File: css.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "css.h"
+
+
+/*
+ * Character classes for the tokenizer.
+ */
+enum {
+	CC_SPACE = 1,	// white space
+	CC_SPECIAL = 2,	// needs attention while scanning a value
+};
+
+static const unsigned char cclass[256] = {
+	['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE,
+	['\f'] = CC_SPACE, ['\r'] = CC_SPACE, [' '] = CC_SPACE,
+	['"'] = CC_SPECIAL, ['\''] = CC_SPECIAL, ['\\'] = CC_SPECIAL,
+	['/'] = CC_SPECIAL, ['('] = CC_SPECIAL, [')'] = CC_SPECIAL,
+	[';'] = CC_SPECIAL, ['}'] = CC_SPECIAL, ['\0'] = CC_SPECIAL,
+};
+
+#define IS_SPACE(C)		( CC_SPACE & cclass[(unsigned char)(C)] )
+#define IS_SPECIAL(C)	( CC_SPECIAL & cclass[(unsigned char)(C)] )
+
+/*
+ * Skip white space and comments.
+ */
+static inline const char *skipws( const char *s )
+{
+	while ( 1 )
+	{
+		while ( IS_SPACE( *s ) )
+			++s;
+		if ( '/' != s[0] || '*' != s[1] )
+			break;
+		if ( NULL == ( s = strstr( s + 2, "*/" ) ) )
+			return "";
+		s += 2;
+	}
+	return s;
+}
+
+static inline cssSpan_t trimspan( const char *s, const char *e )
+{
+	while ( e > s && IS_SPACE( e[-1] ) )
+		--e;
+	return (cssSpan_t){ s, e - s };
+}
+
+/*
+ * Scan to the end of a declaration value, i.e. the next semicolon or
+ * closing brace outside of quotes, parentheses and comments.
+ */
+static inline const char *scanValue( const char *s )
+{
+	int depth = 0;
+	char quot;
+
+	for ( ; ; ++s )
+	{
+		while ( !IS_SPECIAL( *s ) )
+			++s;
+		switch ( *s )
+		{
+		case '\0':
+			return s;
+		case '"':
+		case '\'':
+			for ( quot = *s++; *s && quot != *s; ++s )
+				if ( '\\' == *s && s[1] )
+					++s;
+			if ( !*s )
+				return s;
+			break;
+		case '\\':
+			if ( s[1] )
+				++s;
+			break;
+		case '/':
+			if ( '*' == s[1] )
+			{
+				const char *e = strstr( s + 2, "*/" );
+				if ( !e )
+					return s + strlen( s );
+				s = e + 1;
+			}
+			break;
+		case '(':
+			++depth;
+			break;
+		case ')':
+			if ( depth )
+				--depth;
+			break;
+		case ';':
+		case '}':
+			if ( !depth )
+				return s;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * Fetch the next "name: value" declaration from *ps and advance *ps
+ * past it. The returned spans point into the original string, white
+ * space is trimmed and a trailing !important is dropped. Malformed
+ * declarations are skipped. Returns 1 if a declaration was found,
+ * or 0 at end of input or a closing brace.
+ */
+int cssNextDecl( const char **ps, cssSpan_t *name, cssSpan_t *value )
+{
+	const char *s = *ps, *e;
+
+	while ( 1 )
+	{
+		while ( ';' == *( s = skipws( s ) ) )
+			++s;
+		if ( !*s || '}' == *s )
+			break;
+		// property name
+		for ( e = s; ':' != *e && !IS_SPECIAL( *e ); ++e )
+			;
+		if ( ':' != *e )
+		{	// no colon: skip garbage
+			s = scanValue( e );
+			continue;
+		}
+		*name = trimspan( s, e );
+		// property value
+		s = skipws( e + 1 );
+		e = scanValue( s );
+		*value = trimspan( s, e );
+		*ps = e;
+		if ( 10 <= value->len && 't' == ( value->s[value->len - 1] | 0x20 )
+		  && 0 == strncasecmp( value->s + value->len - 10, "!important", 10 ) )
+			*value = trimspan( value->s, value->s + value->len - 10 );
+		if ( name->len )
+			return 1;
+		s = e;
+	}
+	*ps = s;
+	return 0;
+}
+
+/*
+ * Copy span to NUL terminated buffer. Returns -1 if it did not fit,
+ * in which case buf is left empty rather than truncated.
+ */
+int cssSpanCpy( char *buf, size_t bsz, cssSpan_t sp )
+{
+	if ( sp.len >= bsz )
+	{
+		*buf = '\0';
+		return -1;
+	}
+	memcpy( buf, sp.s, sp.len );
+	buf[sp.len] = '\0';
+	return 0;
+}
+
+
+/************************************************************
+ *	Property table
+ *
+ * Perfect hash over the (lower case) first, middle and last
+ * character. The constants were chosen to be collision free for the
+ * set of presentation attributes the converter understands, plus:
+ * opacity, color, display, visibility, fill-rule, stroke-linejoin,
+ * stroke-linecap, stroke-miterlimit and stroke-dasharray.
+ */
+
+#define PROP_HASHSZ	32
+#define PROP_MINLEN	4
+#define PROP_MAXLEN	17
+
+static inline unsigned propHash( const char *s, size_t len )
+{
+	return ( 3U * tolower( (unsigned char)s[0] )
+			+ 5U * tolower( (unsigned char)s[len - 1] )
+			+ tolower( (unsigned char)s[len / 2] ) ) & ( PROP_HASHSZ - 1 );
+}
+
+static const struct {
+	const char *name;
+	unsigned char len;
+	cssProp_t prop;
+} prop_tab[PROP_HASHSZ] = {
+	[26] = { "fill",			4,	CSS_PROP_FILL },
+	[ 1] = { "stroke",			6,	CSS_PROP_STROKE },
+	[31] = { "fill-opacity",	12,	CSS_PROP_FILL_OPACITY },
+	[ 5] = { "stroke-opacity",	14,	CSS_PROP_STROKE_OPACITY },
+	[14] = { "stroke-width",	12,	CSS_PROP_STROKE_WIDTH },
+	[15] = { "color",			5,	CSS_PROP_COLOR },
+	[11] = { "stroke-linejoin",	15,	CSS_PROP_STROKE_LINEJOIN },
+	[21] = { "stroke-linecap",	14,	CSS_PROP_STROKE_LINECAP },
+	[ 6] = { "stroke-miterlimit",	17,	CSS_PROP_STROKE_MITERLIMIT },
+};
+
+cssProp_t cssProperty( const char *name, size_t len )
+{
+	unsigned h;
+
+	if ( PROP_MINLEN > len || PROP_MAXLEN < len )
+		return CSS_PROP_UNKNOWN;
+	h = propHash( name, len );
+	if ( prop_tab[h].len == len && 0 == strncasecmp( prop_tab[h].name, name, len ) )
+		return prop_tab[h].prop;
+	return CSS_PROP_UNKNOWN;
+}
+
+
+
+/************************************************************
+ *	Style sheets
+ *
+ * Only simple selectors are supported: an optional element name (or
+ * universal selector), an optional #id and any number of .classes,
+ * e.g. "path.cls-1.hot". Selectors using combinators, attribute
+ * selectors or pseudo classes are ignored, as are @-rules. Each rule
+ * is filed into exactly one hash bucket, keyed by its id, else its
+ * first class, else its element name; rules with none of these go
+ * to the universal list. Matching an element thus only visits the
+ * buckets for its id, its classes and its name.
+ */
+
+#define SEL_MAXCLS	8
+
+typedef struct {
+	cssSpan_t elem;				// empty: any element
+	cssSpan_t id;				// empty: no id required
+	cssSpan_t cls[SEL_MAXCLS];
+	int ncls;
+	unsigned spec;				// specificity, ids:classes:elements
+	size_t decl, ndecl;			// declarations in decl pool
+	unsigned hash;				// index key hash
+	int next;					// next rule in same bucket or -1
+} rule_t;
+
+struct cssSheet {
+	rule_t *rule;
+	size_t nrule, szrule;
+	struct { cssProp_t prop; cssSpan_t val; } *decl;
+	size_t ndecl, szdecl;
+	int *bucket;				// bucket heads, -1 for empty
+	size_t nbucket;				// power of two
+	int universal;				// chain of rules without key
+	int *cand;					// match scratch space
+	size_t szcand;
+};
+
+enum {
+	KEY_ELEM = 'e',
+	KEY_ID = '#',
+	KEY_CLASS = '.',
+};
+
+static unsigned keyHash( int kind, const char *s, size_t len )
+{
+	unsigned h = 2166136261U;	// FNV-1a
+
+	h = ( h ^ (unsigned)kind ) * 16777619U;
+	while ( len-- )
+	{
+		unsigned char c = *s++;
+		if ( KEY_ELEM == kind )
+			c = tolower( c );
+		h = ( h ^ c ) * 16777619U;
+	}
+	return h;
+}
+
+static int is_ident( int c )
+{
+	return isalnum( (unsigned char)c ) || '-' == c || '_' == c || 0x80 & c;
+}
+
+cssSheet_t *cssSheetNew( void )
+{
+	cssSheet_t *sh = calloc( 1, sizeof *sh );
+	if ( sh )
+		sh->universal = -1;
+	return sh;
+}
+
+void cssSheetFree( cssSheet_t *sh )
+{
+	if ( !sh )
+		return;
+	free( sh->rule );
+	free( sh->decl );
+	free( sh->bucket );
+	free( sh->cand );
+	free( sh );
+}
+
+size_t cssSheetRules( const cssSheet_t *sh )
+{
+	return sh ? sh->nrule : 0;
+}
+
+static int grow( void **p, size_t *sz, size_t need, size_t elsz )
+{
+	void *q;
+	size_t n = *sz ? *sz : 16;
+
+	if ( need <= *sz )
+		return 0;
+	while ( n < need )
+		n *= 2;
+	if ( NULL == ( q = realloc( *p, n * elsz ) ) )
+		return -1;
+	*p = q;
+	*sz = n;
+	return 0;
+}
+
+/*
+ * Parse a single compound selector in [s,e), return 0 on success or
+ * -1 if unsupported.
+ */
+static int parseSelector( rule_t *r, const char *s, const char *e )
+{
+	const char *b;
+
+	memset( r, 0, sizeof *r );
+	while ( s < e && IS_SPACE( *s ) )
+		++s;
+	while ( e > s && IS_SPACE( e[-1] ) )
+		--e;
+	if ( s == e )
+		return -1;
+	if ( '*' == *s )
+		++s;
+	else if ( is_ident( *s ) )
+	{
+		for ( b = s; s < e && is_ident( *s ); ++s )
+			;
+		r->elem = (cssSpan_t){ b, s - b };
+		r->spec += 1;
+	}
+	while ( s < e )
+	{
+		int kind = *s++;
+		for ( b = s; s < e && is_ident( *s ); ++s )
+			;
+		if ( s == b )
+			return -1;
+		if ( KEY_ID == kind && !r->id.len )
+		{
+			r->id = (cssSpan_t){ b, s - b };
+			r->spec += 1 << 16;
+		}
+		else if ( KEY_CLASS == kind && SEL_MAXCLS > r->ncls )
+		{
+			r->cls[r->ncls++] = (cssSpan_t){ b, s - b };
+			r->spec += 1 << 8;
+		}
+		else
+			return -1;	// combinator, attribute, pseudo class, ...
+	}
+	return 0;
+}
+
+static void indexRule( cssSheet_t *sh, int i )
+{
+	rule_t *r = &sh->rule[i];
+	int *head;
+
+	if ( r->id.len )
+		r->hash = keyHash( KEY_ID, r->id.s, r->id.len );
+	else if ( r->ncls )
+		r->hash = keyHash( KEY_CLASS, r->cls[0].s, r->cls[0].len );
+	else if ( r->elem.len )
+		r->hash = keyHash( KEY_ELEM, r->elem.s, r->elem.len );
+	else
+	{
+		r->next = sh->universal;
+		sh->universal = i;
+		return;
+	}
+	head = &sh->bucket[r->hash & ( sh->nbucket - 1 )];
+	r->next = *head;
+	*head = i;
+}
+
+static int buildIndex( cssSheet_t *sh )
+{
+	size_t i, n = 16;
+	int *p;
+
+	while ( n < 2 * sh->nrule )
+		n *= 2;
+	if ( n != sh->nbucket )
+	{
+		if ( NULL == ( p = realloc( sh->bucket, n * sizeof *p ) ) )
+			return -1;
+		sh->bucket = p;
+		sh->nbucket = n;
+	}
+	for ( i = 0; i < sh->nbucket; ++i )
+		sh->bucket[i] = -1;
+	sh->universal = -1;
+	// insert in reverse, so chains list rules in source order
+	for ( i = sh->nrule; i-- > 0; )
+		indexRule( sh, (int)i );
+	return 0;
+}
+
+/*
+ * Skip an at-rule, either up to its terminating semicolon or past its
+ * (possibly nested) block.
+ */
+static const char *skipAtRule( const char *s )
+{
+	int depth = 0;
+	char quot;
+
+	for ( ; *s; ++s )
+	{
+		switch ( *s )
+		{
+		case '"':
+		case '\'':
+			for ( quot = *s++; *s && quot != *s; ++s )
+				if ( '\\' == *s && s[1] )
+					++s;
+			if ( !*s )
+				return s;
+			break;
+		case '/':
+			if ( '*' == s[1] )
+			{
+				const char *e = strstr( s + 2, "*/" );
+				if ( !e )
+					return s + strlen( s );
+				s = e + 1;
+			}
+			break;
+		case '{':
+			++depth;
+			break;
+		case '}':
+			if ( 1 >= depth-- )
+				return s + 1;
+			break;
+		case ';':
+			if ( !depth )
+				return s + 1;
+			break;
+		default:
+			break;
+		}
+	}
+	return s;
+}
+
+/*
+ * Compile style sheet text and add its rules to the sheet.
+ */
+int cssSheetParse( cssSheet_t *sh, const char *text )
+{
+	const char *s = text, *sel, *e, *c;
+	cssSpan_t name, val;
+	size_t d0;
+	rule_t r;
+
+	while ( 1 )
+	{
+		s = skipws( s );
+		if ( 0 == strncmp( s, "<!--", 4 ) || 0 == strncmp( s, "-->", 3 ) )
+		{	// CDO/CDC tokens
+			s += ( '<' == *s ) ? 4 : 3;
+			continue;
+		}
+		if ( !*s )
+			break;
+		if ( '@' == *s )
+		{
+			s = skipAtRule( s );
+			continue;
+		}
+		// selector list
+		for ( sel = s; *s && '{' != *s; ++s )
+			;
+		if ( !*s )
+			break;
+		e = s++;
+		// declaration block
+		d0 = sh->ndecl;
+		while ( cssNextDecl( &s, &name, &val ) )
+		{
+			cssProp_t prop = cssProperty( name.s, name.len );
+			if ( CSS_PROP_UNKNOWN == prop )
+				continue;
+			if ( 0 != grow( (void **)&sh->decl, &sh->szdecl, sh->ndecl + 1, sizeof *sh->decl ) )
+				return -1;
+			sh->decl[sh->ndecl].prop = prop;
+			sh->decl[sh->ndecl].val = val;
+			++sh->ndecl;
+		}
+		if ( '}' == *s )
+			++s;
+		if ( d0 == sh->ndecl )
+			continue;
+		// one rule per selector in group
+		for ( c = sel; c < e; sel = ++c )
+		{
+			while ( c < e && ',' != *c )
+				++c;
+			if ( 0 != parseSelector( &r, sel, c ) )
+				continue;
+			r.decl = d0;
+			r.ndecl = sh->ndecl - d0;
+			if ( 0 != grow( (void **)&sh->rule, &sh->szrule, sh->nrule + 1, sizeof *sh->rule ) )
+				return -1;
+			sh->rule[sh->nrule++] = r;
+		}
+	}
+	return buildIndex( sh );
+}
+
+static int spaneq( cssSpan_t sp, const char *s, int icase )
+{
+	return icase ? 0 == strncasecmp( sp.s, s, sp.len ) && !s[sp.len]
+				 : 0 == strncmp( sp.s, s, sp.len ) && !s[sp.len];
+}
+
+static int hasClass( const char *classes, cssSpan_t cls )
+{
+	const char *s = classes, *b;
+
+	while ( s && *s )
+	{
+		while ( IS_SPACE( *s ) )
+			++s;
+		for ( b = s; *s && !IS_SPACE( *s ); ++s )
+			;
+		if ( (size_t)( s - b ) == cls.len && 0 == strncmp( b, cls.s, cls.len ) )
+			return 1;
+	}
+	return 0;
+}
+
+static int ruleMatch( const rule_t *r, const char *elem, const char *id, const char *classes )
+{
+	int i;
+
+	if ( r->elem.len && !spaneq( r->elem, elem, 1 ) )
+		return 0;
+	if ( r->id.len && ( !id || !spaneq( r->id, id, 0 ) ) )
+		return 0;
+	for ( i = 0; i < r->ncls; ++i )
+		if ( !hasClass( classes, r->cls[i] ) )
+			return 0;
+	return 1;
+}
+
+static int addCandidates( cssSheet_t *sh, int i, size_t *n, unsigned hash,
+							const char *elem, const char *id, const char *classes )
+{
+	size_t k;
+
+	for ( ; 0 <= i; i = sh->rule[i].next )
+	{
+		const rule_t *r = &sh->rule[i];
+		if ( hash != r->hash || !ruleMatch( r, elem, id, classes ) )
+			continue;
+		// a class rule may be reached through duplicate class names
+		for ( k = 0; k < *n && sh->cand[k] != i; ++k )
+			;
+		if ( k < *n )
+			continue;
+		if ( 0 != grow( (void **)&sh->cand, &sh->szcand, *n + 1, sizeof *sh->cand ) )
+			return -1;
+		sh->cand[(*n)++] = i;
+	}
+	return 0;
+}
+
+/*
+ * Invoke cb for every declaration matching the element, in cascade
+ * order: ascending specificity, source order for equal specificity.
+ */
+int cssSheetApply( cssSheet_t *sh, const char *elem, const char *id,
+					const char *classes, cssApplyCb_t cb, void *usr )
+{
+	size_t n = 0, i, k;
+	const char *s, *b;
+	int j, res = 0;
+
+	if ( !sh || !sh->nrule )
+		return 0;
+	if ( id && *id )
+	{
+		unsigned h = keyHash( KEY_ID, id, strlen( id ) );
+		res |= addCandidates( sh, sh->bucket[h & ( sh->nbucket - 1 )], &n, h, elem, id, classes );
+	}
+	for ( s = classes; s && *s; )
+	{
+		unsigned h;
+		while ( IS_SPACE( *s ) )
+			++s;
+		for ( b = s; *s && !IS_SPACE( *s ); ++s )
+			;
+		if ( s == b )
+			break;
+		h = keyHash( KEY_CLASS, b, s - b );
+		res |= addCandidates( sh, sh->bucket[h & ( sh->nbucket - 1 )], &n, h, elem, id, classes );
+	}
+	if ( elem && *elem )
+	{
+		unsigned h = keyHash( KEY_ELEM, elem, strlen( elem ) );
+		res |= addCandidates( sh, sh->bucket[h & ( sh->nbucket - 1 )], &n, h, elem, id, classes );
+	}
+	for ( j = sh->universal; 0 <= j; j = sh->rule[j].next )
+	{
+		if ( !ruleMatch( &sh->rule[j], elem, id, classes ) )
+			continue;
+		if ( 0 != grow( (void **)&sh->cand, &sh->szcand, n + 1, sizeof *sh->cand ) )
+			return -1;
+		sh->cand[n++] = j;
+	}
+	// insertion sort by specificity, then source order (= rule index)
+	for ( i = 1; i < n; ++i )
+	{
+		int c = sh->cand[i];
+		for ( k = i; k > 0; --k )
+		{
+			const rule_t *p = &sh->rule[sh->cand[k - 1]];
+			if ( p->spec < sh->rule[c].spec
+			  || ( p->spec == sh->rule[c].spec && sh->cand[k - 1] < c ) )
+				break;
+			sh->cand[k] = sh->cand[k - 1];
+		}
+		sh->cand[k] = c;
+	}
+	for ( i = 0; i < n; ++i )
+	{
+		const rule_t *r = &sh->rule[sh->cand[i]];
+		for ( k = r->decl; k < r->decl + r->ndecl; ++k )
+			cb( sh->decl[k].prop, sh->decl[k].val, usr );
+	}
+	return res;
+}
+
+/* EOF */
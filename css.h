@@ -0,0 +1,64 @@
+/*
+ * Minimal CSS declaration tokenizer and property table.
+ *
+ * Project: svg2ass
+ *    File: css.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_CSS_INCLUDED
+#define H_CSS_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <stdlib.h>
+
+typedef struct {
+	const char *s;
+	size_t len;
+} cssSpan_t;
+
+typedef enum {
+	CSS_PROP_UNKNOWN = 0,
+	CSS_PROP_FILL,
+	CSS_PROP_FILL_OPACITY,
+	CSS_PROP_STROKE,
+	CSS_PROP_STROKE_OPACITY,
+	CSS_PROP_STROKE_WIDTH,
+	CSS_PROP_COLOR,
+	CSS_PROP_STROKE_LINEJOIN,
+	CSS_PROP_STROKE_LINECAP,
+	CSS_PROP_STROKE_MITERLIMIT,
+	CSS_PROP_NUM
+} cssProp_t;
+
+int cssNextDecl( const char **ps, cssSpan_t *name, cssSpan_t *value );
+cssProp_t cssProperty( const char *name, size_t len );
+int cssSpanCpy( char *buf, size_t bsz, cssSpan_t sp );
+
+/*
+ * Style sheets; compiled rules keep pointing into the style sheet
+ * source text, which must therefore outlive the sheet.
+ */
+typedef struct cssSheet cssSheet_t;
+typedef void (*cssApplyCb_t)( cssProp_t prop, cssSpan_t val, void *usr );
+
+cssSheet_t *cssSheetNew( void );
+void cssSheetFree( cssSheet_t *sh );
+int cssSheetParse( cssSheet_t *sh, const char *text );
+size_t cssSheetRules( const cssSheet_t *sh );
+int cssSheetApply( cssSheet_t *sh, const char *elem, const char *id,
+					const char *classes, cssApplyCb_t cb, void *usr );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_CSS_INCLUDED
+
+/* EOF */
@@ -20,16 +20,29 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 
 #include <strings.h>
 #include <unistd.h>
 
+#include "arena.h"
 #include "nxml.h"
 #include "colors.h"
+#include "css.h"
 #include "vect.h"
+#include "shape.h"
+#include "stroke.h"
+#include "assbin.h"
+#include "verify.h"
+#include "stats.h"
+#include "trace.h"
+#include "watch.h"
 #include "version.h"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #ifdef DEBUG
 #include <assert.h>
@@ -51,6 +64,9 @@
 #ifndef M_PI
 	#define M_PI 3.14159265358979323846
 #endif
+#ifndef M_SQRT2
+	#define M_SQRT2 1.41421356237309504880
+#endif
 #define DEG2RAD(D)	((double)(D)*M_PI/180.0)
 #define RAD2DEG(R)	((double)(R)*180.0/M_PI)
 
@@ -74,6 +90,12 @@
  */
 #define DFLT_EPSILON	0.001
 
+/*
+ * Memory limit for formatted path and points data kept for reuse,
+ * see memoFind().
+ */
+#define DFLT_MEMO_CAP	( 4UL << 20 )
+
 
 
 /************************************************************
@@ -82,6 +104,9 @@
 
 #define MAX_FPREC	5
 
+// exit status for documents aborted by a resource limit
+#define EXIT_LIMIT	3
+
 static struct {
 	int ass_mode;
 	int ass_fprec;
@@ -95,7 +120,28 @@ static struct {
 	double epsilon;
 	double arcline;
 	FILE *of;
+	const char *of_name;	// output file name, NULL for stdout
 	const char *progname;
+	statsFormat_t stats_fmt;	// statistics output format
+	size_t arena_blk;		// arena block size, 0 for default
+	size_t memo_cap;		// drawing fragment memo limit, 0 disables
+	int memo_cap_set;		// memo limit given, applies in watch mode too
+	const char *layer_fmt;	// per layer output file name template, or NULL
+	int watch;				// watch input file, convert on change
+	struct {				// resource limits, 0 for none
+		unsigned long points;		// points per shape: truncate shape
+		unsigned long long bytes;	// output per document: abort
+		size_t depth;				// element nesting: skip element
+		size_t attrs;				// attributes per element: skip element
+		unsigned long uses;			// <use> elements per document: skip element
+		double time;				// seconds per document: abort
+	} lim;
+	int stroke_outline;		// expand strokes to fill-only outlines
+	double play_w;			// target PlayResX, 0 for none
+	double play_h;			// target PlayResY
+	unsigned long long budget;	// output byte budget, 0 for none
+	int budget_line;		// budget applies per line, not per document
+	double auto_tol;		// automatic precision tolerance [px], 0 for off
 } config = {
 	1,
 	1,
@@ -109,7 +155,21 @@ static struct {
 	DFLT_EPSILON,
 	DFLT_ARCLINE,
 	NULL,
+	NULL,
 	"svg2ass",
+	STATS_FMT_NONE,
+	0,
+	DFLT_MEMO_CAP,
+	0,
+	NULL,
+	0,
+	{ 0, 0, 0, 0, 0, 0.0 },
+	0,
+	0.0,
+	0.0,
+	0,
+	0,
+	0.0,
 };
 
 enum {
@@ -154,30 +214,75 @@ static int err( int lvl, int usg, const char *fmt, ... )
 
 typedef struct {
 	int in_svg;
-	vec_t org;			// origin
+	int hidden;			// inside <defs>, not rendered
 	mtx_t ctm;			// current transformation matrix
+	mtx_kind_t ctm_kind;	// CTM classification, see ctm_apply()
 	unsigned f_col;		// fill color
 	unsigned f_alpha;	// fill aplpha
+	unsigned f_calpha;	// fill color alpha (rgba, none)
 	unsigned s_col;		// stroke color
 	unsigned s_alpha;	// stroke alpha
+	unsigned s_calpha;	// stroke color alpha (rgba, none)
+	unsigned c_col;		// color property, for currentColor
+	unsigned c_alpha;	// color property alpha
+	unsigned curcol;	// bit 0: fill, bit 1: stroke use currentColor
 	double s_width;		// stroke width
+	int s_join;			// stroke line join, STROKE_JOIN_*
+	int s_cap;			// stroke line cap, STROKE_CAP_*
+	double s_miter;		// stroke miter limit
 } ctx_t;
 
 static ctx_t *stack = NULL;
 static size_t stacksz = 0;
 static size_t stacktop = 0;
 
+/*
+ * Per-document allocations (context stack, scratch copies, XML
+ * attribute arrays) come from this arena, which is reset between
+ * documents.
+ */
+static arena_t arena;
+
+/*
+ * Document level state
+ */
+static struct {
+	cssSheet_t *sheet;	// compiled <style> sheets
+	int in_style;		// inside <style> element
+	nxmlOpt_t xopt;		// XML parser options
+	nxmlDom_t *dom;		// document tree, only built for <use>
+	unsigned *ids;		// id index into dom, see useTarget()
+	size_t ids_sz;
+	int use_depth;		// <use> nesting level
+	unsigned use_chain[16];	// targets of the <use> elements being rendered
+	int use_cycle;		// circular reference reported
+	unsigned long uses;	// <use> elements rendered
+	int use_sym;		// next <symbol> is a <use> target
+	struct layerOut *layer;	// output stream of current top-level group
+	unsigned long long out_bytes;	// output written
+	double t0;			// conversion start time
+	int trunc;			// shape truncated by points limit
+	const char *abort;	// limit that aborted the conversion, or NULL
+	struct useShape *ushape[256];	// <use> geometry cache
+	struct budgetRec *brec, *blast;	// shapes held back for the budget
+} doc;
+
+// content the converter has no use for, except inside <style>
+#define XML_IGNORE	( NXML_IGN_TEXT | NXML_IGN_COMMENT | NXML_IGN_CDATA | NXML_IGN_PROC )
+
 static int ctx_push( ctx_t *ctx )
 {
 	if ( stacktop + 1 > stacksz )
 	{
 		ctx_t *p;
-		if ( NULL == ( p = realloc( stack, ( stacksz + CTX_STACKSZ_INC ) * sizeof *stack ) ) )
+		if ( NULL == ( p = arenaGrow( &arena, stack, stacksz * sizeof *stack,
+								( stacksz + CTX_STACKSZ_INC ) * sizeof *stack ) ) )
 			return -1;
 		stack = p;
 		stacksz += CTX_STACKSZ_INC;
 	}
 	stack[stacktop++] = *ctx;
+	STATS_MAX( max_depth, stacktop );
 	return 0;
 }
 
@@ -206,9 +311,44 @@ int emit( const char *fmt, ... )
 	return r < 0 ? -1 : 0;
 }
 #else
-#define emit(...)	(0>fprintf(config.of,__VA_ARGS__)?-1:0)
+#define emit(...)	emitted(fprintf(config.of,__VA_ARGS__))
 #endif
 
+static inline int emitted( int n )
+{
+	if ( 0 > n )
+		return -1;
+	doc.out_bytes += n;
+	STATS_ADD( out_bytes, n );
+	return 0;
+}
+
+/*
+ * Check document limits, output size with n more bytes to be written
+ * and time; once exceeded the conversion is aborted.
+ */
+static int limitOutput( size_t n )
+{
+	if ( doc.abort )
+		return 1;
+	if ( config.lim.bytes && doc.out_bytes + n > config.lim.bytes )
+	{
+		doc.abort = "output size";
+		STATS_INC( lim_bytes );
+	}
+	else if ( config.lim.time > 0 && statsNow() - doc.t0 > config.lim.time )
+	{
+		doc.abort = "time";
+		STATS_INC( lim_time );
+	}
+	return NULL != doc.abort;
+}
+
+static inline int limitDocument( void )
+{
+	return limitOutput( 0 );
+}
+
 /*
  *	Round floating point number to specified precision,
  *	strip trailing zero fractional component.
@@ -229,6 +369,35 @@ static inline char *ftoa( char *buf, int prec, double d )
 	return buf;
 }
 
+/*
+ *	Combine two ASS alpha (transparency) values.
+ */
+static inline unsigned mixAlpha( unsigned a, unsigned b )
+{
+	return 255 - ( ( 255 - a ) * ( 255 - b ) + 127 ) / 255;
+}
+
+/*
+ *	Apply current transformation matrix to point, skipping the
+ *	terms that are known to be zero or one.
+ */
+static inline vec_t ctm_apply( const ctx_t *ctx, vec_t v )
+{
+	const mtx_t *m = &ctx->ctm;
+
+	switch ( ctx->ctm_kind )
+	{
+	case MTX_KIND_IDENTITY:
+		return v;
+	case MTX_KIND_TRANSLATE:
+		return VEC( v.x + m->e, v.y + m->f );
+	case MTX_KIND_SCALE:
+		return VEC( m->a * v.x + m->e, m->d * v.y + m->f );
+	default:
+		return vec_mmul( *m, v );
+	}
+}
+
 /*
  *	Formatted FP output for scalars and vector components, which are
  * 	transforned using the current transformation matrix.
@@ -240,6 +409,7 @@ int emitf( ctx_t *ctx, const char *fmt, ... )
 	vec_t v;
 	va_list arglist;
 	static char buf[3 + DBL_MANT_DIG - DBL_MIN_EXP + 1];
+	STATS_ENTER( STATS_PH_FORMAT );
 
 	va_start( arglist, fmt );
 	for ( p = fmt; *p && 0 == r; ++p )
@@ -254,7 +424,13 @@ int emitf( ctx_t *ctx, const char *fmt, ... )
 				break;
 			case 'v':
 				v = va_arg( arglist, vec_t );
-				v = vec_mmul( ctx->ctm, v );
+				if ( limitDocument() )
+				{
+					r = -1;
+					break;
+				}
+				STATS_INC( points );
+				v = ctm_apply( ctx, v );
 				v = vec_scal( v, config.ass_scale );
 				r = emit( "%s ", ftoa( buf, config.ass_fprec, v.x ) );
 				r = emit( "%s",  ftoa( buf, config.ass_fprec, v.y ) );
@@ -272,15 +448,153 @@ int emitf( ctx_t *ctx, const char *fmt, ... )
 			r = emit( "%c", *p );
 	}
 	va_end( arglist );
+	STATS_LEAVE();
+	return r;
+}
+
+/*
+ *	Growable scratch buffers, for drawing fragments and memo keys.
+ */
+typedef struct {
+	char *s;
+	size_t len;
+	size_t sz;
+} buf_t;
+
+static buf_t obuf;
+static size_t opoints;	// number of points formatted into obuf
+
+static buf_t lbuf;		// dialogue line start
+
+static inline int bufReserve( buf_t *b, size_t n )
+{
+	if ( b->len + n > b->sz )
+	{
+		size_t sz = b->sz ? b->sz : 4096;
+		char *s;
+		while ( sz < b->len + n )
+			sz *= 2;
+		if ( NULL == ( s = realloc( b->s, sz ) ) )
+			return -1;
+		b->s = s;
+		b->sz = sz;
+	}
+	return 0;
+}
+
+static inline int bufPut( buf_t *b, const char *p, size_t n )
+{
+	if ( 0 != bufReserve( b, n ) )
+		return -1;
+	memcpy( b->s + b->len, p, n );
+	b->len += n;
+	return 0;
+}
+
+static int bufPrintf( buf_t *b, const char *fmt, ... )
+{
+	int n;
+	va_list arglist;
+
+	va_start( arglist, fmt );
+	n = vsnprintf( NULL, 0, fmt, arglist );
+	va_end( arglist );
+	if ( 0 > n || 0 != bufReserve( b, n + 1 ) )
+		return -1;
+	va_start( arglist, fmt );
+	vsnprintf( b->s + b->len, n + 1, fmt, arglist );
+	va_end( arglist );
+	b->len += n;
+	return 0;
+}
+
+/*
+ *	Format shape geometry under the current transformation matrix
+ *	into obuf. Document limits are checked as the text grows, counting
+ *	it as pending output unless it is held back for the budget.
+ */
+static int fmtShape( const ctx_t *ctx, const shape_t *shp )
+{
+	int r = 0;
+	size_t i, n, z = 0;
+	vec_t v;
+	char cmd[2] = { 0, ' ' };
+	static char buf[3 + DBL_MANT_DIG - DBL_MIN_EXP + 1];
+	STATS_ENTER( STATS_PH_FORMAT );
+
+	obuf.len = 0;
+	for ( i = 0; i < shp->num && 0 == r; ++i )
+	{
+		if ( 'z' == shp->pt[i].cmd )
+		{
+			++z;
+			continue;
+		}
+		if ( 0 == ( i & 4095 ) && i && limitOutput( config.budget ? 0 : obuf.len ) )
+		{
+			r = -1;
+			break;
+		}
+		if ( shp->pt[i].cmd )
+		{
+			cmd[0] = shp->pt[i].cmd;
+			r |= bufPut( &obuf, cmd, 2 );
+		}
+		v = vec_scal( ctm_apply( ctx, shp->pt[i].v ), config.ass_scale );
+		n = strlen( ftoa( buf, config.ass_fprec, v.x ) );
+		buf[n++] = ' ';
+		r |= bufPut( &obuf, buf, n );
+		n = strlen( ftoa( buf, config.ass_fprec, v.y ) );
+		buf[n++] = ' ';
+		r |= bufPut( &obuf, buf, n );
+	}
+	opoints = i - z;
+	STATS_ADD( points, opoints );
+	STATS_LEAVE();
 	return r;
 }
 
+/*
+ *	Write drawing fragment.
+ */
+static int emitFragment( const char *p, size_t n )
+{
+	STATS_ENTER( STATS_PH_FORMAT );
+	if ( n != fwrite( p, 1, n, config.of ) )
+	{
+		STATS_LEAVE();
+		return -1;
+	}
+	doc.out_bytes += n;
+	STATS_ADD( out_bytes, n );
+	STATS_LEAVE();
+	return 0;
+}
+
 enum {
 	ASS_COMMENT = -1,
 	ASS_CLOSE = 0,
 	ASS_START = 1,
 };
 
+/*
+ *	Format the start of an ASS drawing line into lbuf.
+ */
+static int fmtLineStart( const ctx_t *ctx )
+{
+	static char buf[3 + DBL_MANT_DIG - DBL_MIN_EXP + 1];
+
+	//Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text
+	lbuf.len = 0;
+	return bufPrintf( &lbuf, "Dialogue: %d,%s,%s,%s,%s,0,0,0,,"
+			"{\\an7\\1c&H%06X&\\1a&H%02X&\\3c&H%06X&\\3a&H%02X&\\bord%s\\shad0\\p%d}",
+			config.ass_layer, config.ass_start, config.ass_end,
+			config.ass_style, config.ass_actor,
+			ctx->f_col, mixAlpha( ctx->f_alpha, ctx->f_calpha ),
+			ctx->s_col, mixAlpha( ctx->s_alpha, ctx->s_calpha ),
+			ftoa( buf, config.ass_fprec, ctx->s_width ), config.ass_scale_exp );
+}
+
 /*
  *  Start / finalize ASS drawing line
  */
@@ -288,6 +602,7 @@ static inline int ass_line( ctx_t *ctx, int mode )
 {
 	static int is_open = 0;
 	static int did_comment = 0;
+	STATS_ENTER( STATS_PH_FORMAT );
 
 	if ( ASS_COMMENT == mode && !did_comment )
 	{
@@ -301,22 +616,18 @@ static inline int ass_line( ctx_t *ctx, int mode )
 	}
 	else if ( ASS_START == mode && !is_open )	// start a new ASS line
 	{
-		//Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text
-		emit( "Dialogue: %d,%s,%s,%s,%s,0,0,0,,", config.ass_layer,
-				config.ass_start, config.ass_end,
-				config.ass_style, config.ass_actor );
-		emit( "{\\an7\\1c&H%06X&\\1a&H%02X&\\3c&H%06X&\\3a&H%02X&",
-				ctx->f_col, ctx->f_alpha, ctx->s_col, ctx->s_alpha );
-		emitf( ctx, "\\bord%f\\shad0", ctx->s_width );
-		emit( "\\p%d}", config.ass_scale_exp );
+		if ( 0 == fmtLineStart( ctx ) )
+			emitFragment( lbuf.s, lbuf.len );
 		is_open = 1;
 		++config.ass_layer;
+		STATS_INC( lines );
 	}
 	else if ( ASS_CLOSE == mode && is_open )	// close ASS line
 	{
 		emit( "{\\p0}\n" );
 		is_open = 0;
 	}
+	STATS_LEAVE();
 	return is_open;
 }
 
@@ -334,13 +645,13 @@ static inline int findAttr( const nxmlNode_t *node, const char *name )
 	return -1;
 }
 
-static inline double getNumericAttr( const nxmlNode_t *node, char *attr )
+static inline double getNumericAttr( const nxmlNode_t *node, const char *attr )
 {
 	int a = findAttr( node, attr );
 	return ( 0 <= a ) ? strtod( node->att[a].val, NULL ) : 0.0;
 }
 
-static inline const char *getStringAttr( const nxmlNode_t *node, char *attr )
+static inline const char *getStringAttr( const nxmlNode_t *node, const char *attr )
 {
 	int a = findAttr( node, attr );
 	return ( 0 <= a ) ? node->att[a].val : NULL;
@@ -353,112 +664,187 @@ static inline const char *skip( const char *str, const char *skip )
 	return str;
 }
 
-static int parseStyles( ctx_t *ctx, const nxmlNode_t *node )
+static inline unsigned parseOpacity( const char *s )
 {
-	unsigned nocol = 0;
-	const char *s;
+	double o = atof( s );
+	if ( 0.0 > o )
+		o = 0.0;
+	else if ( 1.0 < o )
+		o = 1.0;
+	return 255 - o * 255;
+}
 
-	// parse presentation attributes
-	IPRINT( "style (presentation attribute)\n" );
-	if ( NULL != ( s = getStringAttr( node, "fill" ) ) )
+/*
+ * Set fill (bit 0) or stroke (bit 1) paint; invalid values are ignored.
+ */
+static void applyPaint( ctx_t *ctx, unsigned bit, const char *s )
+{
+	unsigned col, alpha;
+	int r;
+
+	if ( 0 == strcasecmp( s, "none" ) )
 	{
-		IPRINT( "    fill=%s\n", s );
-		if ( strstr( s, "none" ) )
-			nocol |= 1;
-		else
-		{
-			nocol &= ~1;
-			ctx->f_col = convColorBGR( s );
-		}
+		col = 1 & bit ? ctx->f_col : ctx->s_col;
+		alpha = 255;
+		r = 0;
 	}
-	if ( NULL != ( s = getStringAttr( node, "stroke" ) ) )
+	else if ( 0 > ( r = parseColor( s, &col, &alpha ) ) )
+		return;
+	if ( 0 < r )
 	{
-		IPRINT( "    stroke=%s\n", s );
-		if ( strstr( s, "none" ) )
-			nocol |= 2;
-		else
-		{
-			nocol &= ~2;
-			ctx->s_col = convColorBGR( s );
-		}
+		ctx->curcol |= bit;
+		return;
 	}
-	if ( NULL != ( s = getStringAttr( node, "fill-opacity" ) ) )
+	ctx->curcol &= ~bit;
+	if ( 1 & bit )
 	{
-		IPRINT( "    fill-opacity=%s\n", s );
-		ctx->f_alpha = 255 - atof( s ) * 255;
+		ctx->f_col = col;
+		ctx->f_calpha = alpha;
 	}
-	if ( NULL != ( s = getStringAttr( node, "stroke-opacity" ) ) )
+	else
 	{
-		IPRINT( "    stroke-opacity=%s\n", s );
-		ctx->s_alpha = 255 - atof( s ) * 255;
+		ctx->s_col = col;
+		ctx->s_calpha = alpha;
 	}
-	if ( NULL != ( s = getStringAttr( node, "stroke-width" ) ) && *s  )
+}
+
+/*
+ * Apply a single presentation attribute or CSS declaration.
+ */
+static void applyProperty( ctx_t *ctx, cssProp_t prop, cssSpan_t val )
+{
+	char buf[128];
+	unsigned col, alpha;
+
+	if ( CSS_PROP_UNKNOWN == prop || 0 != cssSpanCpy( buf, sizeof buf, val ) )
+		return;
+	IPRINT( "    %d=%s\n", prop, buf );
+	switch ( prop )
 	{
-		IPRINT( "    stroke-width=%s\n", s );
-		ctx->s_width = atof( s );
+	case CSS_PROP_FILL:
+		applyPaint( ctx, 1, buf );
+		break;
+	case CSS_PROP_STROKE:
+		applyPaint( ctx, 2, buf );
+		break;
+	case CSS_PROP_COLOR:
+		if ( 0 == parseColor( buf, &col, &alpha ) )
+		{
+			ctx->c_col = col;
+			ctx->c_alpha = alpha;
+		}
+		break;
+	case CSS_PROP_FILL_OPACITY:
+		ctx->f_alpha = parseOpacity( buf );
+		break;
+	case CSS_PROP_STROKE_OPACITY:
+		ctx->s_alpha = parseOpacity( buf );
+		break;
+	case CSS_PROP_STROKE_WIDTH:
+		if ( *buf )
+			ctx->s_width = atof( buf );
+		break;
+	case CSS_PROP_STROKE_LINEJOIN:
+		if ( 0 == strcasecmp( buf, "miter" ) )
+			ctx->s_join = STROKE_JOIN_MITER;
+		else if ( 0 == strcasecmp( buf, "round" ) )
+			ctx->s_join = STROKE_JOIN_ROUND;
+		else if ( 0 == strcasecmp( buf, "bevel" ) )
+			ctx->s_join = STROKE_JOIN_BEVEL;
+		break;
+	case CSS_PROP_STROKE_LINECAP:
+		if ( 0 == strcasecmp( buf, "butt" ) )
+			ctx->s_cap = STROKE_CAP_BUTT;
+		else if ( 0 == strcasecmp( buf, "round" ) )
+			ctx->s_cap = STROKE_CAP_ROUND;
+		else if ( 0 == strcasecmp( buf, "square" ) )
+			ctx->s_cap = STROKE_CAP_SQUARE;
+		break;
+	case CSS_PROP_STROKE_MITERLIMIT:
+		if ( 1.0 <= atof( buf ) )
+			ctx->s_miter = atof( buf );
+		break;
+	default:
+		break;
 	}
+}
 
-	// parse inline CSS
-	IPRINT( "style (inline CSS)\n" );
-	if ( NULL != ( s = getStringAttr( node, "style" ) ) && *s )
+static void applySheetProperty( cssProp_t prop, cssSpan_t val, void *usr )
+{
+	applyProperty( usr, prop, val );
+}
+
+static int parseStyleSheet( const char *text )
+{
+	if ( !doc.sheet && NULL == ( doc.sheet = cssSheetNew() ) )
+		return -1;
+	IPRINT( "style sheet\n" );
+	return cssSheetParse( doc.sheet, text );
+}
+
+static int parseStyles( ctx_t *ctx, const nxmlNode_t *node )
+{
+	size_t a;
+	const char *style = NULL, *id = NULL, *cls = NULL;
+	cssSpan_t name, val;
+	STATS_ENTER( STATS_PH_STYLE );
+
+	// parse presentation attributes
+	IPRINT( "style (presentation attribute)\n" );
+	for ( a = 0; a < node->att_num; ++a )
 	{
-		int n = 0;
-		char name[100];
-		char value[100];
+		const char *n = node->att[a].name;
+		const char *v = node->att[a].val;
+		cssProp_t prop = cssProperty( n, strlen( n ) );
+		if ( CSS_PROP_UNKNOWN != prop )
+			applyProperty( ctx, prop, (cssSpan_t){ v, strlen( v ) } );
+		else if ( 0 == strcasecmp( n, "style" ) )
+			style = v;
+		else if ( 0 == strcasecmp( n, "class" ) )
+			cls = v;
+		else if ( 0 == strcasecmp( n, "id" ) )
+			id = v;
+	}
 
-		while ( sscanf( s, " %99[^ :] : %99[^ ;] %n", name, value, &n ) == 2 )
-		{
-			s = skip( s + n, ";" );
-			IPRINT( "    %s=%s\n", name, value );
-			if ( 0 == strcasecmp( name, "fill" ) )
-			{
-				if ( 0 == strcasecmp( value, "none" ) )
-					nocol |= 1;
-				else
-				{
-					nocol &= ~1;
-					ctx->f_col = convColorBGR( value );
-				}
-			}
-			else if ( 0 == strcasecmp( name, "stroke" ) )
-			{
-				if ( 0 == strcasecmp( value, "none" ) )
-					nocol |= 2;
-				else
-				{
-					nocol &= ~2;
-					ctx->s_col = convColorBGR( value );
-				}
-			}
-			else if ( 0 == strcasecmp( name, "fill-opacity" ) )
-				ctx->f_alpha = 255 - atof( value ) * 255;
-			else if ( 0 == strcasecmp( name, "stroke-opacity" ) )
-				ctx->s_alpha = 255 - atof( value ) * 255;
-			else if ( 0 == strcasecmp( name, "stroke-width" ) )
-				ctx->s_width = atof( value );
-		}
+	// apply matching style sheet rules
+	if ( doc.sheet )
+	{
+		IPRINT( "style (sheet)\n" );
+		cssSheetApply( doc.sheet, node->name, id, cls, applySheetProperty, ctx );
 	}
 
-	// a color set to "none" is emulated by setting full transparency
-	if ( nocol & 1 )
-		ctx->f_alpha = 255;
-	if ( nocol & 2 )
-		ctx->s_alpha = 255;
+	// parse inline CSS, overriding presentation attributes
+	IPRINT( "style (inline CSS)\n" );
+	while ( style && cssNextDecl( &style, &name, &val ) )
+		applyProperty( ctx, cssProperty( name.s, name.len ), val );
+
+	// resolve currentColor, after color itself is known
+	if ( ctx->curcol & 1 )
+	{
+		ctx->f_col = ctx->c_col;
+		ctx->f_calpha = ctx->c_alpha;
+	}
+	if ( ctx->curcol & 2 )
+	{
+		ctx->s_col = ctx->c_col;
+		ctx->s_calpha = ctx->c_alpha;
+	}
 	//IPRINT( "    fill #%06x %u; stroke #%06x %u %g\n", ctx->f_col, ctx->f_alpha, ctx->s_col, ctx->s_alpha, ctx->s_width );
+	STATS_LEAVE();
 	return 0;
 }
 
-static int parseTransform( ctx_t *ctx, const char *trf )
+/*
+ * Compose the matrix for a transform attribute value.
+ */
+static mtx_t transformMatrix( const char *trf )
 {
 	int a = 0, n;
 	const char *s = trf;
 	char op[100];
 	double phi;
-	mtx_t m;
+	mtx_t m, t = MTX_UNI;
 
-	if ( !s || !*s )
-		return 0;
-	IPRINT( "transform\n" );
 	while ( *s )
 	{
 		if ( sscanf( s, " %99[^ (]%n", op, &n ) != 1 || !*op )
@@ -501,8 +887,8 @@ static int parseTransform( ctx_t *ctx, const char *trf )
 				  || 2 == sscanf( s, " %lf %lf%n", &m.e, &m.f, &n ) )
 				{
 					s += n;
-					ctx->ctm = mtx_mmul( ctx->ctm, m );
-					ctx->ctm = mtx_mmul( ctx->ctm, r );
+					t = mtx_mmul( t, m );
+					t = mtx_mmul( t, r );
 					m.e = -m.e;
 					m.f = -m.f;
 				}
@@ -541,79 +927,282 @@ static int parseTransform( ctx_t *ctx, const char *trf )
 		}
 		if ( 0 < a )
 		{
-			ctx->ctm = mtx_mmul( ctx->ctm, m );
-			IPRINT( "    %s(%g,%g,%g,%g,%g,%g) --> CTM(%g,%g,%g,%g,%g,%g)\n",
-					op, m.a, m.b, m.c, m.d, m.e, m.f,
-					ctx->ctm.a, ctx->ctm.b, ctx->ctm.c,
-					ctx->ctm.d, ctx->ctm.e, ctx->ctm.f );
+			t = mtx_mmul( t, m );
+			IPRINT( "    %s(%g,%g,%g,%g,%g,%g)\n",
+					op, m.a, m.b, m.c, m.d, m.e, m.f );
 		}
 		sscanf( s, "%*[ 0-9.)]%n", &n );
 		s += n;
 	}
-	return 0;
+	return t;
 }
 
-
-/************************************************************
- *	SVG parsing and ASS drawing
+/*
+ * Transform attribute cache: documents tend to repeat the same few
+ * transform strings over and over, so parsed matrices are kept in a
+ * small direct mapped table. Longer strings are not cached.
  */
+#define TRF_CACHE_SZ	256		// power of two
+#define TRF_KEY_MAX		64
 
-static int ass_roundrect( ctx_t *ctx, vec_t o, vec_t d, vec_t r )
-{
-	int res = 0;
-	vec_t c, v0, v1, v2, v3, rq;
-	int h_edge, v_edge;
+static struct {
+	char key[TRF_KEY_MAX];
+	mtx_t m;
+} trf_cache[TRF_CACHE_SZ];
 
-	if ( d.x / 2 < r.x )
-		r.x = d.x / 2;
-	if ( d.y / 2 < r.y )
-		r.y = d.y / 2;
+static int parseTransform( ctx_t *ctx, const char *trf )
+{
+	size_t len;
+	unsigned h = 2166136261u;
+	const char *s;
+	mtx_t m;
 
-	if ( config.epsilon > r.x && config.epsilon > r.y )	// square corner shortcut
+	if ( !trf || !*trf )
+		return 0;
+	STATS_ENTER( STATS_PH_STYLE );
+	IPRINT( "transform\n" );
+	for ( s = trf; *s; ++s )
+		h = ( h ^ (unsigned char)*s ) * 16777619u;
+	len = s - trf;
+	h &= TRF_CACHE_SZ - 1;
+	if ( len < TRF_KEY_MAX && 0 == strcmp( trf_cache[h].key, trf ) )
 	{
-		if ( config.epsilon > d.x && config.epsilon > d.y )	// tiny extent optimization
-			res = emitf( ctx, "m %v l %v ", o, VEC( o.x+config.epsilon, o.y ) );
-		else
-			res = emitf( ctx, "m %v l %v %v %v ", o, (vec_t){o.x+d.x, o.y},
-						vec_add( o, d ), (vec_t){o.x, o.y+d.y} );
-		return res;
+		m = trf_cache[h].m;
+		STATS_INC( trf_hits );
+	}
+	else
+	{
+		m = transformMatrix( trf );
+		if ( len < TRF_KEY_MAX )
+		{
+			memcpy( trf_cache[h].key, trf, len + 1 );
+			trf_cache[h].m = m;
+		}
+		STATS_INC( trf_misses );
 	}
+	ctx->ctm = mtx_mmul( ctx->ctm, m );
+	ctx->ctm_kind = mtx_kind( ctx->ctm );
+	IPRINT( "    --> CTM(%g,%g,%g,%g,%g,%g) kind %d\n",
+			ctx->ctm.a, ctx->ctm.b, ctx->ctm.c,
+			ctx->ctm.d, ctx->ctm.e, ctx->ctm.f, ctx->ctm_kind );
+	STATS_LEAVE();
+	return 0;
+}
 
-	// prepare parameters, move to start position
-	rq = vec_scal( r, BEZIER_CIRC );
-	h_edge = config.epsilon < ( d.x - 2 * r.x );
-	v_edge = config.epsilon < ( d.y - 2 * r.y );
-	v0.x = o.x + r.x;	v0.y = o.y;
-	res += emitf( ctx, "m %v ", v0 );
+/*
+ * Length attribute in px, at 96 dpi; 0 for percentages, font relative
+ * units and anything else that cannot be resolved here.
+ */
+static double lengthPx( const char *s )
+{
+	static const struct {
+		const char *unit;
+		double px;
+	} ut[] = {
+		{ "", 1.0 }, { "px", 1.0 }, { "pt", 96.0 / 72.0 }, { "pc", 16.0 },
+		{ "mm", 96.0 / 25.4 }, { "cm", 96.0 / 2.54 }, { "in", 96.0 },
+	};
+	char *e;
+	double v;
+	size_t i;
+
+	if ( NULL == s )
+		return 0.0;
+	v = strtod( s, &e );
+	e = (char *)skip( e, " \t\r\n" );
+	for ( i = 0; i < sizeof ut / sizeof *ut; ++i )
+		if ( 0 == strncasecmp( e, ut[i].unit, 2 ) && !*skip( e + strlen( ut[i].unit ), " \t\r\n" ) )
+			return v > 0.0 ? v * ut[i].px : 0.0;
+	return 0.0;
+}
 
-	if ( h_edge )
-	{	// upper edge
-		v0.x = o.x + d.x - r.x;	v0.y = o.y;
-		res += emitf( ctx, "l %v ", v0 );
+/*
+ * Map the root viewBox (or, lacking one, the width and height) to
+ * the requested PlayRes, as if the latter was the viewport, following
+ * preserveAspectRatio.
+ */
+static void rootViewport( ctx_t *ctx, const nxmlNode_t *node )
+{
+	const char *par = getStringAttr( node, "preserveAspectRatio" );
+	const char *vbs = getStringAttr( node, "viewBox" );
+	double vb[4] = { 0.0, 0.0, 0.0, 0.0 };
+	double sx, sy;
+	char align[9] = "xMidYMid", mos[6] = "meet";
+	int n = 0;
+	mtx_t m = MTX_UNI;
+
+	if ( vbs && 4 == sscanf( vbs, " %lf%*[ ,\t\r\n]%lf%*[ ,\t\r\n]%lf%*[ ,\t\r\n]%lf",
+								&vb[0], &vb[1], &vb[2], &vb[3] )
+		&& 0.0 < vb[2] && 0.0 < vb[3] )
+		;
+	else
+	{
+		vb[0] = vb[1] = 0.0;
+		vb[2] = lengthPx( getStringAttr( node, "width" ) );
+		vb[3] = lengthPx( getStringAttr( node, "height" ) );
+		if ( 0.0 >= vb[2] || 0.0 >= vb[3] )
+		{
+			err( ELVL_WARNING, 0, "<svg>: no viewBox or absolute size, PlayRes ignored" );
+			return;
+		}
 	}
-	c.x = v0.x;			c.y = v0.y + r.y;
-	v1.x = c.x + rq.x;	v1.y = c.y - r.y;
-	v2.x = c.x + r.x;	v2.y = c.y - rq.y;
-	v3.x = c.x + r.x;	v3.y = c.y;
-	res += emitf( ctx, "b %v %v %v ", v1, v2, v3 );
-
-	if ( v_edge )
-	{	// right edge
-		v0.x = o.x + d.x;	v0.y = o.y + d.y - r.y;
-		res += emitf( ctx, "l %v ", v0 );
+	if ( par )
+	{
+		sscanf( par, " defer %n", &n );
+		sscanf( par + n, " %8s %5s", align, mos );
 	}
-	else
+	sx = config.play_w / vb[2];
+	sy = config.play_h / vb[3];
+	if ( 0 != strcasecmp( align, "none" ) )
+	{
+		sx = sy = ( 0 == strcasecmp( mos, "slice" ) ) ? fmax( sx, sy ) : fmin( sx, sy );
+		if ( 0 == strncasecmp( align, "xMid", 4 ) )
+			m.e = ( config.play_w - vb[2] * sx ) / 2;
+		else if ( 0 == strncasecmp( align, "xMax", 4 ) )
+			m.e = config.play_w - vb[2] * sx;
+		if ( 0 == strcasecmp( align + 4, "YMid" ) )
+			m.f = ( config.play_h - vb[3] * sy ) / 2;
+		else if ( 0 == strcasecmp( align + 4, "YMax" ) )
+			m.f = config.play_h - vb[3] * sy;
+	}
+	m.a = sx;
+	m.d = sy;
+	m.e -= vb[0] * sx;
+	m.f -= vb[1] * sy;
+	IPRINT( "    viewport %gx%g at (%g,%g) -> %gx%g\n", vb[2], vb[3], vb[0], vb[1],
+			config.play_w, config.play_h );
+	ctx->ctm = mtx_mmul( ctx->ctm, m );
+	ctx->ctm_kind = mtx_kind( ctx->ctm );
+}
+
+/*
+ * Style and transform attributes common to all elements.
+ */
+static void parseCommon( ctx_t *ctx, const nxmlNode_t *node )
+{
+	traceMark();
+	parseStyles( ctx, node );
+	parseTransform( ctx, getStringAttr( node, "transform" ) );
+	traceSpan( "style", 1 );
+	traceMark();
+}
+
+
+/************************************************************
+ *	SVG parsing and ASS drawing
+ */
+
+/*
+ * Geometry of the element being converted; the buffer is kept across
+ * elements and documents.
+ */
+static shape_t shape;
+
+static inline int draw( int cmd, vec_t v )
+{
+	if ( config.lim.points && shape.num >= config.lim.points )
+	{
+		doc.trunc = 1;
+		errno = E2BIG;
+		return -1;
+	}
+	return shpAdd( &shape, cmd, v );
+}
+
+/*
+ * Check element limits, nesting depth and attribute count; elements
+ * exceeding them are skipped with all their content.
+ */
+static int limitElement( const nxmlNode_t *node )
+{
+	if ( config.lim.depth && stacktop > config.lim.depth )
+	{
+		STATS_INC( lim_depth );
+		return 1;
+	}
+	if ( config.lim.attrs && node->att_num > config.lim.attrs )
+	{
+		STATS_INC( lim_attrs );
+		return 1;
+	}
+	return 0;
+}
+
+static inline int drawLine( vec_t v1, vec_t v2 )
+{
+	return draw( 'm', v1 ) | draw( 'l', v2 );
+}
+
+static inline int drawBezier( vec_t v1, vec_t v2, vec_t v3 )
+{
+	return draw( 'b', v1 ) | draw( 0, v2 ) | draw( 0, v3 );
+}
+
+/*
+ * Mark the end of a closed subpath; not written out, as ASS knows
+ * only closed shapes, but needed to stroke the subpath properly.
+ */
+static inline int drawClose( void )
+{
+	return draw( 'z', VEC_ZERO );
+}
+
+static int ass_roundrect( vec_t o, vec_t d, vec_t r )
+{
+	int res = 0;
+	vec_t c, v0, v1, v2, v3, rq;
+	int h_edge, v_edge;
+
+	if ( d.x / 2 < r.x )
+		r.x = d.x / 2;
+	if ( d.y / 2 < r.y )
+		r.y = d.y / 2;
+
+	if ( config.epsilon > r.x && config.epsilon > r.y )	// square corner shortcut
+	{
+		if ( config.epsilon > d.x && config.epsilon > d.y )	// tiny extent optimization
+			res = drawLine( o, VEC( o.x+config.epsilon, o.y ) );
+		else
+			res = draw( 'm', o ) | draw( 'l', (vec_t){o.x+d.x, o.y} )
+				| draw( 0, vec_add( o, d ) ) | draw( 0, (vec_t){o.x, o.y+d.y} );
+		return res;
+	}
+
+	// prepare parameters, move to start position
+	rq = vec_scal( r, BEZIER_CIRC );
+	h_edge = config.epsilon < ( d.x - 2 * r.x );
+	v_edge = config.epsilon < ( d.y - 2 * r.y );
+	v0.x = o.x + r.x;	v0.y = o.y;
+	res += draw( 'm', v0 );
+
+	if ( h_edge )
+	{	// upper edge
+		v0.x = o.x + d.x - r.x;	v0.y = o.y;
+		res += draw( 'l', v0 );
+	}
+	c.x = v0.x;			c.y = v0.y + r.y;
+	v1.x = c.x + rq.x;	v1.y = c.y - r.y;
+	v2.x = c.x + r.x;	v2.y = c.y - rq.y;
+	v3.x = c.x + r.x;	v3.y = c.y;
+	res += drawBezier( v1, v2, v3 );
+
+	if ( v_edge )
+	{	// right edge
+		v0.x = o.x + d.x;	v0.y = o.y + d.y - r.y;
+		res += draw( 'l', v0 );
+	}
+	else
 		v0 = v3;
 	c.x = v0.x - r.x;	c.y = v0.y;
 	v1.x = c.x + r.x;	v1.y = c.y + rq.y;
 	v2.x = c.x + rq.x;	v2.y = c.y + r.y;
 	v3.x = c.x;			v3.y = c.y + r.y;
-	res += emitf( ctx, "b %v %v %v ", v1, v2, v3 );
+	res += drawBezier( v1, v2, v3 );
 
 	if ( h_edge )
 	{	// lower edge
 		v0.x = o.x + r.x;	v0.y = o.y + d.y;
-		res += emitf( ctx, "l %v ", v0 );
+		res += draw( 'l', v0 );
 	}
 	else
 		v0 = v3;
@@ -621,12 +1210,12 @@ static int ass_roundrect( ctx_t *ctx, vec_t o, vec_t d, vec_t r )
 	v1.x = c.x - rq.x;	v1.y = c.y + r.y;
 	v2.x = c.x - r.x;	v2.y = c.y + rq.y;
 	v3.x = c.x - r.x;	v3.y = c.y;
-	res += emitf( ctx, "b %v %v %v ", v1, v2, v3 );
+	res += drawBezier( v1, v2, v3 );
 
 	if ( v_edge )
 	{	// left edge
 		v0.x = o.x;			v0.y = o.y + r.y;
-		res += emitf( ctx, "l %v ", v0 );
+		res += draw( 'l', v0 );
 	}
 	else
 		v0 = v3;
@@ -634,22 +1223,22 @@ static int ass_roundrect( ctx_t *ctx, vec_t o, vec_t d, vec_t r )
 	v1.x = c.x - r.x;	v1.y = c.y - rq.y;
 	v2.x = c.x - rq.x;	v2.y = c.y - r.y;
 	v3.x = c.x;			v3.y = c.y - r.y;
-	res += emitf( ctx, "b %v %v %v ", v1, v2, v3 );
+	res += drawBezier( v1, v2, v3 );
 
 	return res;
 }
 
-static int ass_ellipse( ctx_t *ctx, vec_t c, vec_t r )
+static int ass_ellipse( vec_t c, vec_t r )
 {
 	if ( config.epsilon > r.x && config.epsilon > r.y )
 	{	// tiny radius shortcut
-		return emitf( ctx, "m %v l %v ", c, vec_add( c, VEC(1,0) ) );
+		return drawLine( c, vec_add( c, VEC(1,0) ) );
 	}
 	// Ellipses are basically just degenerate rounded rects.
-	return ass_roundrect( ctx, vec_sub( c, r ), vec_scal( r, 2.0 ), r );
+	return ass_roundrect( vec_sub( c, r ), vec_scal( r, 2.0 ), r );
 }
 
-static int ass_arc( ctx_t *ctx, vec_t v0, vec_t r, double phi, int fa, int fs, vec_t v )
+static int ass_arc( vec_t v0, vec_t r, double phi, int fa, int fs, vec_t v )
 {
 	// Draw an elliptical arc, Ref:
 	// http://www.w3.org/TR/SVG/implnote.html#ArcSyntax
@@ -660,7 +1249,7 @@ static int ass_arc( ctx_t *ctx, vec_t v0, vec_t r, double phi, int fa, int fs, v
 		return 0;
 	// F.6.6 Step 1: Ensure radii are non-zero (otherwise draw straight line)
 	if ( config.epsilon > r.x || config.epsilon > r.y || vec_eq( v0, v, config.epsilon ) )
-		return emitf( ctx, "l %v ", v );
+		return draw( 'l', v );
 	// F.6.6 Step 2: Ensure radii are positive
 	r.x = fabs( r.x );
 	r.y = fabs( r.y );
@@ -681,6 +1270,7 @@ static int ass_arc( ctx_t *ctx, vec_t v0, vec_t r, double phi, int fa, int fs, v
 	// http://www.w3.org/TR/SVG/implnote.html#ArcConversionEndpointToCenter
 
 	double f, t, t1, dt;
+	int cmd = 'l';
 	vec_t p, cp, h1, h2;
 	vec_t c;
 	mtx_t rot = MTX( cos(phi), sin(phi), 0,  -sin(phi), cos(phi), 0 );
@@ -706,7 +1296,6 @@ static int ass_arc( ctx_t *ctx, vec_t v0, vec_t r, double phi, int fa, int fs, v
 	// Perform the sweep in specified direction and draw arc segments
 	double step = config.arcline * 2 / ( r.x + r.y );
 	// TODO: use bezier curves instead of lines
-	emit( "l " );
 	if ( fs )
 	{
 		if ( 0.0 > dt )
@@ -715,7 +1304,10 @@ static int ass_arc( ctx_t *ctx, vec_t v0, vec_t r, double phi, int fa, int fs, v
 		for ( t = 0.0; t < dt; t += step )
 		{
 			p = vec_add( vec_mmul( rot, VEC( r.x*cos(t1+t), r.y*sin(t1+t) ) ), c );
-			emitf( ctx, "%v ", p );
+			if ( 0 != draw( cmd, p ) || ( 0 == ( shape.num & 4095 ) && limitDocument() ) )
+				return -1;
+			cmd = 0;
+			STATS_INC( arc_segs );
 		}
 	}
 	else
@@ -726,21 +1318,26 @@ static int ass_arc( ctx_t *ctx, vec_t v0, vec_t r, double phi, int fa, int fs, v
 		for ( t = 0.0; t > dt; t -= step )
 		{
 			p = vec_add( vec_mmul( rot, VEC( r.x*cos(t1+t), r.y*sin(t1+t) ) ), c );
-			emitf( ctx, "%v ", p );
+			if ( 0 != draw( cmd, p ) || ( 0 == ( shape.num & 4095 ) && limitDocument() ) )
+				return -1;
+			cmd = 0;
+			STATS_INC( arc_segs );
 		}
 	}
-	return emitf( ctx, "%v", v );
+	STATS_INC( arc_segs );
+	return draw( cmd, v );
 }
 
 /*
  * Path parser logic shamelessly stolen from libsvgtiny:
  * http://www.netsurf-browser.org/projects/libsvgtiny/
  */
-static int ass_path( ctx_t *ctx, const char *pd )
+static int ass_path( const char *pd )
 {
 	int res = 0;
 	char *s, *d;
-	vec_t last = ctx->org;
+	arenaMark_t mark;
+	vec_t last = VEC_ZERO;
 	vec_t last_cubic = last;
 	vec_t last_quad = last;
 	vec_t subpath_first = last;
@@ -748,24 +1345,25 @@ static int ass_path( ctx_t *ctx, const char *pd )
 	if ( !pd || !*pd )
 		return 0;
 	/* obtain a clean copy of path */
-	if ( NULL == ( d = strdup( pd ) ) )
+	mark = arenaMark( &arena );
+	if ( NULL == ( d = arenaStrdup( &arena, pd ) ) )
 		return -1;
 	for ( s = d; *s; ++s )
 		if ( ',' == *s )
 			*s = ' ';
 
-	for ( s = d; *s; )
+	for ( s = d; *s && !doc.trunc && !limitDocument(); )
 	{
 		int n;
 		char svg_cmd[2] = "";
 		vec_t v, v1, v2, r;
 		double rot;
 		int larc, swp;
+		int ass_cmd;
 
 		/* moveto (M, m), lineto (L, l) (2 arguments) */
 		if ( sscanf( s, " %1[MmLl]%lf%lf %n", svg_cmd, &v.x, &v.y, &n ) == 3 )
 		{
-			char ass_cmd;
 			if ( *svg_cmd == 'M' || *svg_cmd == 'm' )
 			{
 				IPRINT( "moveto\n" );
@@ -778,12 +1376,12 @@ static int ass_path( ctx_t *ctx, const char *pd )
 			}
 			do
 			{
-				emit( "%c ", ass_cmd );
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				if ( *svg_cmd == 'l' || *svg_cmd == 'm' )
 					v = vec_add( v, last );
 				if ( ass_cmd == 'm' )
 					subpath_first = v;
-				emitf( ctx, "%v ", v );
+				draw( ass_cmd, v );
 				last_cubic = last_quad = last = v;
 				s += n;
 				ass_cmd = 'l';
@@ -794,8 +1392,10 @@ static int ass_path( ctx_t *ctx, const char *pd )
 		else if ( sscanf(s, " %1[Zz] %n", svg_cmd, &n) == 1 )
 		{
 			IPRINT( "closepath\n" );
+			STATS_INC( pcmd['Z' - 'A'] );
 			// in ASS paths are automatically closed
 			// IOW: there are no "open" paths, only closed shapes!
+			drawClose();
 			s += n;
 			last_cubic = last_quad = last = subpath_first;
 		}
@@ -803,13 +1403,15 @@ static int ass_path( ctx_t *ctx, const char *pd )
 		else if ( sscanf( s, " %1[Hh]%lf %n", svg_cmd, &v.x, &n ) == 2 )
 		{
 			IPRINT( "h-lineto\n" );
-			emit( "l " );
+			ass_cmd = 'l';
 			v.y = last.y;
 			do
 			{
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				if ( *svg_cmd == 'h' )
 					v.x += last.x;
-				emitf( ctx, "%v ", v );
+				draw( ass_cmd, v );
+				ass_cmd = 0;
 				last_cubic = last_quad = last = v;
 				s += n;
 			}
@@ -819,13 +1421,15 @@ static int ass_path( ctx_t *ctx, const char *pd )
 		else if ( sscanf( s, " %1[Vv]%lf %n", svg_cmd, &v.y, &n ) == 2 )
 		{
 			IPRINT( "v-lineto\n" );
-			emit( "l " );
+			ass_cmd = 'l';
 			v.x = last.x;
 			do
 			{
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				if ( *svg_cmd == 'v' )
 					v.y += last.y;
-				emitf( ctx, "%v ", v );
+				draw( ass_cmd, v );
+				ass_cmd = 0;
 				last_cubic = last_quad = last = v;
 				s += n;
 			}
@@ -838,13 +1442,14 @@ static int ass_path( ctx_t *ctx, const char *pd )
 			IPRINT( "c-bezier\n" );
 			do
 			{
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				if ( *svg_cmd == 'c' )
 				{
 					v1 = vec_add( v1, last );
 					v2 = vec_add( v2, last );
 					v  = vec_add( v , last );
 				}
-				emitf( ctx, "b %v %v %v ", v1, v2, v );
+				drawBezier( v1, v2, v );
 				last_cubic = v2;
 				last_quad = last = v;
 				s += n;
@@ -859,13 +1464,14 @@ static int ass_path( ctx_t *ctx, const char *pd )
 			IPRINT( "s-bezier\n" );
 			do
 			{
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				v1 = vec_add( last, vec_sub( last, last_cubic ) );
 				if ( *svg_cmd == 's' )
 				{
 					v2 = vec_add( v2, last );
 					v = vec_add( v, last );
 				}
-				emitf( ctx, "b %v %v %v ", v1, v2, v );
+				drawBezier( v1, v2, v );
 				last_cubic = v2;
 				last_quad = last = v;
 				s += n;
@@ -880,14 +1486,14 @@ static int ass_path( ctx_t *ctx, const char *pd )
 			IPRINT( "q-bezier\n" );
 			do
 			{
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				last_quad = v;
 				if ( *svg_cmd == 'q' )
 				{
 					v1 = vec_add( v1, last );
 					v = vec_add( v, last );
 				}
-				emitf( ctx, "b %v %v %v ",
-					vec_add( vec_scal( last, 1./3 ), vec_scal( v1, 2./3 ) ),
+				drawBezier( vec_add( vec_scal( last, 1./3 ), vec_scal( v1, 2./3 ) ),
 					vec_add( vec_scal( v1, 2./3 ), vec_scal( v, 1./3 ) ),
 					v );
 				last_cubic = last = v;
@@ -901,6 +1507,7 @@ static int ass_path( ctx_t *ctx, const char *pd )
 			IPRINT( "t-bezier\n" );
 			do
 			{
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				v1 = vec_add( last, vec_sub( last, last_quad ) );
 				last_quad = v1;
 				if ( *svg_cmd == 't' )
@@ -908,10 +1515,9 @@ static int ass_path( ctx_t *ctx, const char *pd )
 					v1 = vec_add( v1, last );
 					v = vec_add( v, last );
 				}
-				emitf( ctx, "b %v %v %v ",
-					vec_add( vec_scal( last, 1./3 ), vec_scal( v1, 2./3 ) ),
+				drawBezier( vec_add( vec_scal( last, 1./3 ), vec_scal( v1, 2./3 ) ),
 					vec_add( vec_scal( v1, 2./3 ), vec_scal( v, 1./3 ) ),
-					v ),
+					v );
 				last_cubic = last = v;
 				s += n;
 			}
@@ -924,9 +1530,10 @@ static int ass_path( ctx_t *ctx, const char *pd )
 			IPRINT( "arc\n" );
 			do
 			{
+				STATS_INC( pcmd[toupper( (unsigned char)*svg_cmd ) - 'A'] );
 				if ( *svg_cmd == 'a' )
 					v = vec_add( v, last );
-				res = ass_arc( ctx, last, r, rot, larc, swp, v );
+				res = ass_arc( last, r, rot, larc, swp, v );
 				last_cubic = last_quad = last = v;
 				s += n;
 			}
@@ -941,231 +1548,1781 @@ static int ass_path( ctx_t *ctx, const char *pd )
 			break;
 		}
 	}
-	free( d );
+	arenaRelease( &arena, mark );
 	return res;
 }
 
-static int ass_polyline( ctx_t *ctx, const char *pt )
+/*
+ * Read next number from a points list; numbers are separated by
+ * white space, a comma, or both.
+ */
+static inline int nextCoord( const char **ps, double *d, int first )
 {
-	int res = -1;
-	int n;
-	char *d;
-	float dummy;
-
-	if ( pt && *pt
-		&& sscanf( pt, "%f ,%f %n", &dummy, &dummy, &n ) == 2
-		&& NULL != ( d = malloc( strlen( pt ) + 4 + 1 ) ) )
-	{
-		strcpy( d, "M " );
-		strncat( d, pt, n );
-		strcat( d, "L " );
-		strcat( d, pt + n );
-		res = ass_path( ctx, d );	// Ain't we sneaky?
-		free( d );
-	}
-	return res;
+	const char *s = *ps;
+	char *e;
+
+	while ( isspace( (unsigned char)*s ) )
+		++s;
+	if ( !first && ',' == *s )
+		++s;
+	*d = strtod( s, &e );
+	if ( e == s )
+		return 0;
+	*ps = e;
+	return 1;
 }
 
 /*
- * Callback function for XML parser
+ * Polylines and polygons: number pairs are read straight from the
+ * points attribute. On errors the points read so far are still
+ * rendered, as the SVG spec demands.
  */
-static int svg2ass( nxmlEvent_t evt, const nxmlNode_t *node, void *usr )
+static int ass_polyline( const char *pt )
 {
-	int res = 0;
-	ctx_t *ctx = usr;
-	vec_t v1, v2, c, r;
+	const char *s = pt;
+	size_t n = 0;
+	int odd = 0;
+	vec_t v;
 
-	if ( NXML_TYPE_PARENT != node->type
-		&& NXML_TYPE_SELF != node->type
-		&& NXML_TYPE_END != node->type )
+	if ( !pt )
 		return 0;
-
-	switch ( evt )
+	while ( nextCoord( &s, &v.x, 0 == n ) )
 	{
-	case NXML_EVT_OPEN:
-		if ( 0 == strcasecmp( node->name, "svg" ) )
+		if ( !nextCoord( &s, &v.y, 0 ) )
 		{
-			if ( ctx->in_svg )
-				err( ELVL_WARNING, 0, "nested <svg> element!" );
-			ctx->in_svg++;
-		}
-		if ( !ctx->in_svg )
+			odd = 1;
 			break;
-		IPRINT( "<%s \n", node->name );
-		if ( 0 != ctx_push( ctx ) )
-			err( ELVL_FATAL, 0, "context stack push: %s", strerror( errno ) );
-
-		if ( 0 == strcasecmp( node->name, "svg" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-		}
-		else if ( 0 == strcasecmp( node->name, "g" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-		}
-		else if ( 0 == strcasecmp( node->name,  "line" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-			ass_line( ctx, ASS_START );
-			v1.x = ctx->org.x + getNumericAttr( node, "x1" );
-			v1.y = ctx->org.y + getNumericAttr( node, "y1" );
-			v2.x = ctx->org.x + getNumericAttr( node, "x2" );
-			v2.y = ctx->org.y + getNumericAttr( node, "y2" );
-			IPRINT( "x1=%g, y1=%g, x2=%g, y2=%g\n", v1.x, v1.y, v2.x, v2.y );
-			res = emitf( ctx, "m %v l %v ", v1, v2 );
-		}
-		else if ( 0 == strcasecmp( node->name, "rect" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-			ass_line( ctx, 	ASS_START );
-			v1.x = ctx->org.x + getNumericAttr( node, "x" );
-			v1.y = ctx->org.y + getNumericAttr( node, "y" );
-			v2.x = getNumericAttr( node, "width" );
-			v2.y = getNumericAttr( node, "height" );
-			r.x = getNumericAttr( node, "rx" );
-			r.y = getNumericAttr( node, "ry" );
-			if ( 0 > r.x )	r.x = 0;
-			if ( 0 > r.y )	r.y = 0;
-			if ( 0 == r.x )	r.x = r.y;
-			if ( 0 == r.y )	r.y = r.x;
-			IPRINT( "x=%g, y=%g, w=%g, h=%g, rx=%f, ry=%f\n",
-						v1.x, v1.y, v2.x, v2.y, r.x, r.y );
-			res = ass_roundrect( ctx, v1, v2, r );
-		}
-		else if ( 0 == strcasecmp( node->name, "circle" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-			ass_line( ctx, ASS_START );
-			c.x = ctx->org.x + getNumericAttr( node, "cx" );
-			c.y = ctx->org.y + getNumericAttr( node, "cy" );
-			r.x = r.y = getNumericAttr( node, "r" );
-			IPRINT( "x=%g, y=%g, r=%g\n", c.x, c.y, r.x );
-			res = ass_ellipse( ctx, c, r );
-		}
-		else if ( 0 == strcasecmp( node->name, "ellipse" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-			ass_line( ctx, ASS_START );
-			c.x = ctx->org.x + getNumericAttr( node, "cx" );
-			c.y = ctx->org.y + getNumericAttr( node, "cy" );
-			r.x = getNumericAttr( node, "rx" );
-			r.y = getNumericAttr( node, "ry" );
-			IPRINT( "x=%g, y=%g, rx=%g, ry=%g\n", c.x, c.y, r.x, r.y );
-			res = ass_ellipse( ctx, c, r );
-		}
-		else if ( 0 == strcasecmp( node->name, "path" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-			ass_line( ctx, ASS_START );
-			res = ass_path( ctx, getStringAttr( node, "d" ) );
-		}
-		else if ( 0 == strcasecmp( node->name, "polyline" )
-				|| 0 == strcasecmp( node->name, "polygon" ) )
-		{
-			parseStyles( ctx, node );
-			parseTransform( ctx, getStringAttr( node, "transform" ) );
-			ass_line( ctx, ASS_START );
-			res = ass_polyline( ctx, getStringAttr( node, "points" ) );
-		}
-		else
-		{
-			//IPRINT( "*ignored*\n" );
-		}
-		break;
-
-	case NXML_EVT_CLOSE:
-		if ( 0 == strcasecmp( node->name, "svg" ) )
-		{
-			if ( !ctx->in_svg )
-				err( ELVL_WARNING, 0, "excess </svg> element!" );
-			ctx->in_svg--;
 		}
-		ctx_pop( ctx );
-		if ( !ctx->in_svg )
-			break;
-		IPRINT( "/>\n" );
-		break;
-
-	default:
-		break;
+		if ( 0 != draw( n++ ? 'l' : 'm', v ) )
+			return -1;
 	}
-	if ( 1 == config.ass_mode )
-		ass_line( ctx, ASS_CLOSE );
-	if ( 0 != res )
-	{	// report errors, but keep going!
-		err( ELVL_ERROR, 0, "%s: %s", __func__, strerror( errno ) );
-		res = 0;
+	while ( isspace( (unsigned char)*s ) )
+		++s;
+	if ( *s )
+	{
+		err( ELVL_WARNING, 0, "malformed points list at \"%.20s\"", s );
+		errno = EINVAL;
+		return -1;
 	}
-	return res;
+	if ( odd )
+	{
+		err( ELVL_WARNING, 0, "odd number of coordinates in points list" );
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Elements whose content is never rendered directly, or not at all;
+ * editor specific elements are recognized by their namespace prefix.
+ */
+static int isNonRendered( const char *name )
+{
+	static const char *const nr[] = {
+		"metadata", "title", "desc", "script", "foreignObject",
+		"clipPath", "mask", "pattern", "marker", "symbol", "filter",
+		"linearGradient", "radialGradient", NULL
+	};
+	int i;
+
+	if ( strchr( name, ':' ) )
+		return 1;
+	for ( i = 0; nr[i]; ++i )
+		if ( 0 == strcasecmp( name, nr[i] ) )
+			return 1;
+	return 0;
+}
+
+/*
+ * Element geometry; coordinates are taken as is, in user space.
+ */
+typedef int (*geomFn_t)( const nxmlNode_t *node );
+
+typedef struct {
+	const char *name;
+	geomFn_t fn;
+	const char *data;	// attribute holding the geometry, if any
+} geom_t;
+
+static int geomLine( const nxmlNode_t *node )
+{
+	vec_t v1, v2;
+
+	v1.x = getNumericAttr( node, "x1" );
+	v1.y = getNumericAttr( node, "y1" );
+	v2.x = getNumericAttr( node, "x2" );
+	v2.y = getNumericAttr( node, "y2" );
+	IPRINT( "x1=%g, y1=%g, x2=%g, y2=%g\n", v1.x, v1.y, v2.x, v2.y );
+	return drawLine( v1, v2 );
+}
+
+static int geomRect( const nxmlNode_t *node )
+{
+	vec_t o, d, r;
+
+	o.x = getNumericAttr( node, "x" );
+	o.y = getNumericAttr( node, "y" );
+	d.x = getNumericAttr( node, "width" );
+	d.y = getNumericAttr( node, "height" );
+	r.x = getNumericAttr( node, "rx" );
+	r.y = getNumericAttr( node, "ry" );
+	if ( 0 > r.x )	r.x = 0;
+	if ( 0 > r.y )	r.y = 0;
+	if ( 0 == r.x )	r.x = r.y;
+	if ( 0 == r.y )	r.y = r.x;
+	IPRINT( "x=%g, y=%g, w=%g, h=%g, rx=%f, ry=%f\n", o.x, o.y, d.x, d.y, r.x, r.y );
+	return ass_roundrect( o, d, r ) | drawClose();
+}
+
+static int geomCircle( const nxmlNode_t *node )
+{
+	vec_t c, r;
+
+	c.x = getNumericAttr( node, "cx" );
+	c.y = getNumericAttr( node, "cy" );
+	r.x = r.y = getNumericAttr( node, "r" );
+	IPRINT( "x=%g, y=%g, r=%g\n", c.x, c.y, r.x );
+	return ass_ellipse( c, r ) | drawClose();
+}
+
+static int geomEllipse( const nxmlNode_t *node )
+{
+	vec_t c, r;
+
+	c.x = getNumericAttr( node, "cx" );
+	c.y = getNumericAttr( node, "cy" );
+	r.x = getNumericAttr( node, "rx" );
+	r.y = getNumericAttr( node, "ry" );
+	IPRINT( "x=%g, y=%g, rx=%g, ry=%g\n", c.x, c.y, r.x, r.y );
+	return ass_ellipse( c, r ) | drawClose();
+}
+
+static int geomPath( const nxmlNode_t *node )
+{
+	return ass_path( getStringAttr( node, "d" ) );
+}
+
+static int geomPoly( const nxmlNode_t *node )
+{
+	if ( 0 != ass_polyline( getStringAttr( node, "points" ) ) )
+		return -1;
+	return strcasecmp( node->name, "polygon" ) ? 0 : drawClose();
+}
+
+static const geom_t *geomFunc( const char *name )
+{
+	static const geom_t gt[] = {
+		{ "path", geomPath, "d" },
+		{ "rect", geomRect, NULL },
+		{ "circle", geomCircle, NULL },
+		{ "ellipse", geomEllipse, NULL },
+		{ "line", geomLine, NULL },
+		{ "polyline", geomPoly, "points" },
+		{ "polygon", geomPoly, "points" },
+		{ NULL, NULL, NULL }
+	};
+	int i;
+
+	for ( i = 0; gt[i].name; ++i )
+		if ( 0 == strcasecmp( name, gt[i].name ) )
+			return &gt[i];
+	return NULL;
 }
 
 
 /************************************************************
- *	Main program stuff
+ *	Element reuse: <use>, <symbol>, <defs>
+ *
+ * Documents containing <use> elements are parsed into a DOM first,
+ * referenced elements are then converted by replaying their subtree
+ * under the context of the <use> element. The geometry of shapes
+ * reached that way is kept per document, keyed by input offset, so
+ * each shape is converted only once, no matter how often it is used;
+ * style and transformation are still applied per instance.
  */
 
-static int getFile( char **pbuf, size_t *psz, size_t inc, FILE *pf )
+#define USE_DEPTH_MAX	( sizeof doc.use_chain / sizeof *doc.use_chain )
+#define USE_CACHE_SZ	( sizeof doc.ushape / sizeof *doc.ushape )
+
+static int svg2ass( nxmlEvent_t evt, const nxmlNode_t *node, void *usr );
+
+struct useShape {
+	size_t offset;
+	shape_t shp;
+	struct useShape *next;
+};
+
+static inline size_t strHash( const char *s )
 {
-	size_t x = 0, n;
-	char *buf = *pbuf;
+	size_t h = 2166136261u;
 
-	do
+	while ( *s )
+		h = ( h ^ (unsigned char)*s++ ) * 16777619u;
+	return h;
+}
+
+/*
+ * Find the element referenced by an IRI "#id"; the id index is an
+ * open addressing hash table, built on first use.
+ */
+static unsigned useTarget( const char *iri )
+{
+	const char *iid = nxmlDomName( doc.dom, "id" );
+	const char *id;
+	size_t i, n, h;
+
+	if ( !iri || '#' != *iri++ || !iid )
+		return 0;
+	if ( !doc.ids )
 	{
-		if ( x + inc + 1 >= *psz )
+		for ( n = 0, i = 1; i < doc.dom->nnode; ++i )
+			n += NULL != nxmlDomAttr( doc.dom, i, iid );
+		for ( doc.ids_sz = 16; doc.ids_sz < 2 * n; doc.ids_sz *= 2 )
+			;
+		if ( NULL == ( doc.ids = arenaAlloc( &arena, doc.ids_sz * sizeof *doc.ids ) ) )
+			return 0;
+		memset( doc.ids, 0, doc.ids_sz * sizeof *doc.ids );
+		for ( i = 1; i < doc.dom->nnode; ++i )
 		{
-			if ( NULL == ( buf = realloc( buf, *psz + inc + 1 ) ) )
-				return -1;
-			*pbuf = buf;
-			*psz += inc + 1;
+			if ( NULL == ( id = nxmlDomAttr( doc.dom, i, iid ) ) )
+				continue;
+			for ( h = strHash( id ); doc.ids[h & ( doc.ids_sz - 1 )]; ++h )
+				;
+			doc.ids[h & ( doc.ids_sz - 1 )] = i;
 		}
-		n = fread( buf + x, 1, inc, pf );
-		x += n;
-	}
-	while ( 0 < n );
-	buf[x++] = '\0';
-	if ( x < *psz && NULL != ( buf = realloc( buf, x ) ) )
-	{
-		*pbuf = buf;
-		*psz = x;
 	}
-	return ferror( pf );
+	for ( h = strHash( iri ); 0 != ( i = doc.ids[h & ( doc.ids_sz - 1 )] ); ++h )
+		if ( 0 == strcmp( iri, nxmlDomAttr( doc.dom, i, iid ) ) )
+			return i;
+	return 0;
+}
+
+/*
+ * Check whether element t contains the <use> element at offset, or is
+ * the target of one of the <use> elements being rendered.
+ */
+static int useCircular( unsigned t, size_t offset )
+{
+	const nxmlDomNode_t *n = &doc.dom->node[t];
+	int i;
+
+	if ( n->offset <= offset && ( n->end >= doc.dom->nnode || offset < doc.dom->node[n->end].offset ) )
+		return 1;
+	for ( i = 0; i < doc.use_depth; ++i )
+		if ( doc.use_chain[i] == t )
+			return 1;
+	return 0;
 }
 
-static int parse( FILE *fp )
+/*
+ * Render the element referenced by a <use> element, x and y are
+ * applied as additional translation. Circular references are an
+ * error, the <use> element is not rendered.
+ */
+static int useElement( ctx_t *ctx, const nxmlNode_t *node )
 {
+	const char *href = getStringAttr( node, "href" );
+	unsigned t;
+	vec_t d;
 	int res;
-	char *svg = NULL;
-	size_t sz = 0;
-	ctx_t ctx;
 
-	if ( 0 != getFile( &svg, &sz, 4000, fp ) )
+	if ( !href )
+		href = getStringAttr( node, "xlink:href" );
+	if ( !doc.dom || 0 == ( t = useTarget( href ) ) )
 	{
-		err( ELVL_WARNING, 0, "getFile: %s", strerror( errno ) );
-		free( svg );
-		return -1;
+		err( ELVL_WARNING, 0, "<use>: unresolved reference \"%s\"", href ? href : "" );
+		return 0;
+	}
+	if ( useCircular( t, node->offset ) )
+	{
+		if ( !doc.use_cycle++ )
+			err( ELVL_WARNING, 0, "<use>: circular reference \"%s\"", href );
+		return 0;
+	}
+	if ( USE_DEPTH_MAX <= (size_t)doc.use_depth )
+	{
+		err( ELVL_WARNING, 0, "<use>: nesting too deep at \"%s\"", href );
+		return 0;
+	}
+	if ( config.lim.uses && ++doc.uses > config.lim.uses )
+	{
+		STATS_INC( lim_uses );
+		return 0;
+	}
+	d.x = getNumericAttr( node, "x" );
+	d.y = getNumericAttr( node, "y" );
+	if ( 0 != d.x || 0 != d.y )
+	{
+		ctx->ctm = mtx_mmul( ctx->ctm, MTX( 1, 0, d.x, 0, 1, d.y ) );
+		ctx->ctm_kind = mtx_kind( ctx->ctm );
+	}
+	doc.use_sym = ( 0 == strcasecmp( doc.dom->node[t].name, "symbol" ) );
+	doc.use_chain[doc.use_depth++] = t;
+	res = nxmlDomWalk( doc.dom, t, svg2ass, ctx );
+	--doc.use_depth;
+	doc.use_sym = 0;
+	return res;
+}
+
+
+
+/************************************************************
+ *	Drawing fragment memo
+ *
+ * Path data and points lists are often repeated verbatim (markers,
+ * glyphs, hatching), frequently under the same transformation. The
+ * formatted output is therefore remembered, keyed by the source text,
+ * CTM, precision and scale, making repeats a single copy. To not
+ * waste time and memory on data that never repeats, output is only
+ * stored on its second sighting, as recorded in a hash bitmap. The
+ * memo lives across documents; when full, it is flushed as a whole.
+ *
+ * In watch mode the memo holds the previous conversion instead: every
+ * shape element is keyed by its complete markup, i.e. name and
+ * attributes, and stored on first sighting. Entries not used by a
+ * conversion are dropped afterwards, see memoSweep(), so the memo is
+ * sized by the document itself; a limit applies only if given with -C.
+ */
+
+#define MEMO_SLOTS	1024		// power of two
+#define MEMO_SEEN	65536		// bits, power of two
+
+typedef struct memoEnt {
+	struct memoEnt *next;
+	size_t hash;
+	unsigned gen;		// last conversion using this entry
+	mtx_t ctm;
+	int prec;
+	int scale;
+	double eps;
+	double arcl;
+	size_t srclen;
+	size_t outlen;
+	size_t points;
+	char data[];		// source text, followed by output
+} memoEnt_t;
+
+static struct {
+	memoEnt_t *slot[MEMO_SLOTS];
+	size_t bytes;
+	unsigned gen;		// conversion count
+	unsigned char seen[MEMO_SEEN / 8];
+} memo;
+
+static inline size_t memoHash( const char *src, size_t len, const ctx_t *ctx )
+{
+	const unsigned char *p = (const unsigned char *)&ctx->ctm;
+	size_t h = 2166136261u, i;
+
+	for ( i = 0; i < len; ++i )
+		h = ( h ^ (unsigned char)src[i] ) * 16777619u;
+	for ( i = 0; i < sizeof ctx->ctm; ++i )
+		h = ( h ^ p[i] ) * 16777619u;
+	h = ( h ^ config.ass_fprec ) * 16777619u;
+	h = ( h ^ (size_t)( config.arcline * 1000 ) ) * 16777619u;
+	return ( h ^ config.ass_scale ) * 16777619u;
+}
+
+static void memoClear( void )
+{
+	memoEnt_t *e, *n;
+	size_t i;
+
+	for ( i = 0; i < MEMO_SLOTS; ++i )
+	{
+		for ( e = memo.slot[i]; e; e = n )
+		{
+			n = e->next;
+			free( e );
+		}
+		memo.slot[i] = NULL;
+	}
+	memo.bytes = 0;
+	memset( memo.seen, 0, sizeof memo.seen );
+}
+
+/*
+ * Drop all entries not used since the last sweep.
+ */
+static void memoSweep( void )
+{
+	memoEnt_t *e, **pe;
+	size_t i;
+
+	for ( i = 0; i < MEMO_SLOTS; ++i )
+	{
+		for ( pe = &memo.slot[i]; NULL != ( e = *pe ); )
+		{
+			if ( e->gen == memo.gen )
+			{
+				pe = &e->next;
+				continue;
+			}
+			*pe = e->next;
+			memo.bytes -= sizeof *e + e->srclen + e->outlen;
+			free( e );
+		}
+	}
+	++memo.gen;
+}
+
+static const memoEnt_t *memoFind( const char *src, size_t len, size_t h, const ctx_t *ctx )
+{
+	memoEnt_t *e;
+
+	for ( e = memo.slot[h & ( MEMO_SLOTS - 1 )]; e; e = e->next )
+	{
+		if ( e->hash == h && e->srclen == len
+			&& e->prec == config.ass_fprec && e->scale == config.ass_scale
+			&& e->eps == config.epsilon && e->arcl == config.arcline
+			&& 0 == memcmp( &e->ctm, &ctx->ctm, sizeof e->ctm )
+			&& 0 == memcmp( e->data, src, len ) )
+		{
+			e->gen = memo.gen;
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static void memoAdd( const char *src, size_t len, size_t h, const ctx_t *ctx,
+					const char *out, size_t outlen, size_t points )
+{
+	size_t sz = sizeof( memoEnt_t ) + len + outlen;
+	size_t bit = ( h >> 10 ) & ( MEMO_SEEN - 1 );
+	size_t cap = config.watch && !config.memo_cap_set ? (size_t)-1 : config.memo_cap;
+	memoEnt_t *e;
+
+	if ( !config.watch && !( memo.seen[bit / 8] & ( 1u << bit % 8 ) ) )
+	{
+		memo.seen[bit / 8] |= 1u << bit % 8;
+		return;
+	}
+	if ( sz > cap )
+		return;
+	if ( memo.bytes + sz > cap )
+	{
+		if ( config.watch )
+			return;
+		memoClear();
+		STATS_INC( memo_flushes );
+	}
+	if ( NULL == ( e = malloc( sz ) ) )
+		return;
+	e->hash = h;
+	e->gen = memo.gen;
+	e->ctm = ctx->ctm;
+	e->prec = config.ass_fprec;
+	e->scale = config.ass_scale;
+	e->eps = config.epsilon;
+	e->arcl = config.arcline;
+	e->srclen = len;
+	e->outlen = outlen;
+	e->points = points;
+	memcpy( e->data, src, len );
+	memcpy( e->data + len, out, outlen );
+	e->next = memo.slot[h & ( MEMO_SLOTS - 1 )];
+	memo.slot[h & ( MEMO_SLOTS - 1 )] = e;
+	memo.bytes += sz;
+}
+
+
+/************************************************************
+ *	Binary export
+ *
+ * Shapes written out are also written to the binary export file, if
+ * one was given, in the ASS drawing coordinates of the text output,
+ * but unrounded; see assbin.h.
+ */
+
+static struct {
+	assbinWriter_t w;
+	float *xy;
+	unsigned char *cmd;
+	size_t sz;
+} bin;
+
+/*
+ * Dialogue time in centiseconds, from H:MM:SS.CC
+ */
+static unsigned assTime( const char *s )
+{
+	unsigned h = 0, m = 0, sec = 0, cs = 0;
+
+	sscanf( s, "%u:%u:%u.%u", &h, &m, &sec, &cs );
+	return ( ( h * 60 + m ) * 60 + sec ) * 100 + cs;
+}
+
+static int binShape( const ctx_t *ctx, const shape_t *shp )
+{
+	assbinShape_t s;
+	size_t i, n = 0;
+	vec_t v;
+
+	if ( !bin.w.fp )
+		return 0;
+	if ( bin.sz < shp->num )
+	{
+		float *xy = realloc( bin.xy, 2 * shp->num * sizeof *xy );
+		unsigned char *cmd = xy ? realloc( bin.cmd, shp->num ) : NULL;
+		if ( xy )
+			bin.xy = xy;
+		if ( !cmd )
+			return -1;
+		bin.cmd = cmd;
+		bin.sz = shp->num;
+	}
+	s.bbox[0] = s.bbox[1] = HUGE_VALF;
+	s.bbox[2] = s.bbox[3] = -HUGE_VALF;
+	for ( i = 0; i < shp->num; ++i )
+	{
+		if ( 'z' == shp->pt[i].cmd )
+			continue;
+		v = vec_scal( ctm_apply( ctx, shp->pt[i].v ), config.ass_scale );
+		bin.xy[2 * n] = v.x;
+		bin.xy[2 * n + 1] = v.y;
+		bin.cmd[n++] = shp->pt[i].cmd;
+		s.bbox[0] = fminf( s.bbox[0], v.x );
+		s.bbox[1] = fminf( s.bbox[1], v.y );
+		s.bbox[2] = fmaxf( s.bbox[2], v.x );
+		s.bbox[3] = fmaxf( s.bbox[3], v.y );
+	}
+	if ( !n )
+		s.bbox[0] = s.bbox[1] = s.bbox[2] = s.bbox[3] = 0.0f;
+	s.layer = config.ass_layer - 1;	// already counted by ass_line()
+	s.start_cs = assTime( config.ass_start );
+	s.end_cs = assTime( config.ass_end );
+	s.fill = (unsigned)mixAlpha( ctx->f_alpha, ctx->f_calpha ) << 24 | ctx->f_col;
+	s.stroke = (unsigned)mixAlpha( ctx->s_alpha, ctx->s_calpha ) << 24 | ctx->s_col;
+	s.width = ctx->s_width;
+	s.pexp = config.ass_scale_exp;
+	s.num = n;
+	return assbinWrite( &bin.w, &s, bin.xy, bin.cmd );
+}
+
+
+/************************************************************
+ *	Fidelity check
+ *
+ * With a check file given, each filled shape written out is compared
+ * to its reference geometry: the element is converted once more with
+ * arcs split into VERIFY_ARC_DIV times as many segments and epsilon
+ * optimizations off, while the output shape is read back from the
+ * formatted drawing commands, as the renderer gets them. Both are
+ * compared in output pixels, see verify.c; results go to the check
+ * file, one tab separated line per shape, and a summary per document
+ * to stderr. Under a document budget the reference is the shape as
+ * converted, before simplification. Stroke outlines are not checked.
+ */
+
+#define VERIFY_ARC_DIV	64
+
+static struct {
+	FILE *fp;
+	int cap;				// read back the next shape formatted
+	const char *doc;		// document name
+	const char *elem, *id;	// element being converted
+	size_t offset;
+	shape_t ref, out;		// in output pixels
+	unsigned long num;		// per document summary
+	double iou_min, iou_sum, haus_max;
+	char worst[80];
+} vfy;
+
+/*
+ * Read the output shape back from the drawing commands in obuf, each
+ * number followed by a blank.
+ */
+static int verifyRead( void )
+{
+	const char *s = obuf.s, *e = obuf.s + obuf.len;
+	char *q;
+	double k = ldexp( 1.0, 1 - config.ass_scale_exp );
+	int cmd = 0, r = 0;
+	vec_t v;
+
+	vfy.out.num = 0;
+	while ( s < e && 0 == r )
+	{
+		if ( ' ' == *s )
+			++s;
+		else if ( isalpha( (unsigned char)*s ) )
+			cmd = *s++;
+		else
+		{
+			v.x = strtod( s, &q );
+			v.y = strtod( q, &q );
+			s = q;
+			r = shpAdd( &vfy.out, cmd, vec_scal( v, k ) );
+			cmd = 0;
+		}
+	}
+	return r;
+}
+
+/*
+ * Compare reference shape ref, under the CTM of ctx, to the shape last
+ * read back, and record the result.
+ */
+static int verifyReport( const ctx_t *ctx, const shape_t *ref, const char *elem, const char *id, size_t offset )
+{
+	double k = config.ass_scale * ldexp( 1.0, 1 - config.ass_scale_exp );
+	verify_t v;
+	size_t i;
+	int r = 0;
+
+	vfy.ref.num = 0;
+	for ( i = 0; i < ref->num && 0 == r; ++i )
+		r = shpAdd( &vfy.ref, ref->pt[i].cmd, vec_scal( ctm_apply( ctx, ref->pt[i].v ), k ) );
+	if ( 0 != r || 0 != verifyShapes( &vfy.ref, &vfy.out, &v ) )
+		return -1;
+	fprintf( vfy.fp, "%s\t%s\t%s\t%zu\t%.6f\t%.4f\t%.4f\t%.4f\t%.4f\n", vfy.doc, elem,
+			id ? id : "", offset, v.iou, v.diff, v.area_ref, v.area_out, v.hausdorff );
+	if ( !vfy.num || v.iou < vfy.iou_min )
+		vfy.iou_min = v.iou;
+	if ( !vfy.num || v.hausdorff > vfy.haus_max )
+	{
+		vfy.haus_max = v.hausdorff;
+		snprintf( vfy.worst, sizeof vfy.worst, "%s%s%s at %zu", elem,
+				id ? " #" : "", id ? id : "", offset );
+	}
+	vfy.iou_sum += v.iou;
+	++vfy.num;
+	return 0;
+}
+
+/*
+ * Convert element once more to the reference geometry, leaving the
+ * statistics alone, and check the shape last written against it.
+ */
+static int verifyShape( const ctx_t *ctx, const nxmlNode_t *node, geomFn_t fn )
+{
+	double arcline = config.arcline, epsilon = config.epsilon;
+	size_t points = config.lim.points;
+	unsigned long pcmd[26], arc_segs = stats.arc_segs, pts = stats.points;
+	int r;
+
+	memcpy( pcmd, stats.pcmd, sizeof pcmd );
+	config.arcline /= VERIFY_ARC_DIV;
+	config.epsilon = 0.0;
+	config.lim.points = 0;
+	shape.num = 0;
+	r = fn( node );
+	config.arcline = arcline;
+	config.epsilon = epsilon;
+	config.lim.points = points;
+	memcpy( stats.pcmd, pcmd, sizeof pcmd );
+	stats.arc_segs = arc_segs;
+	stats.points = pts;
+	doc.trunc = 0;
+	return r || verifyReport( ctx, &shape, node->name, getStringAttr( node, "id" ), node->offset );
+}
+
+static void verifyDoc( void )
+{
+	if ( vfy.num )
+		err( ELVL_INFO, 0, "%s: %lu shapes checked: IoU min %.4f, mean %.4f; Hausdorff "
+				"max %.4g px, %s", vfy.doc, vfy.num, vfy.iou_min, vfy.iou_sum / vfy.num,
+				vfy.haus_max, vfy.worst );
+	vfy.num = 0;
+	vfy.iou_sum = 0.0;
+}
+
+
+/************************************************************
+ *	Output budget
+ *
+ * With a byte budget set, output precision, \p scale exponent and line
+ * simplification tolerance are searched for the smallest error bound
+ * that fits, either per dialogue line or per document. Shapes are kept
+ * transformed to output space, so trying a candidate only costs
+ * formatting. For the document budget all shapes are held back and
+ * written out at the end by budgetFlush().
+ */
+
+#define BUDGET_DEXP		4	// \p exponent increments tried
+
+// simplification tolerances tried, in pixels
+static const double budget_tol[] = { 0.0, 0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 4.0 };
+
+#define BUDGET_TOL_NUM	( sizeof budget_tol / sizeof *budget_tol )
+
+typedef struct {
+	int prec;			// output precision
+	int dexp;			// \p exponent increment
+	double tol;			// simplification tolerance [px]
+	double err;			// error bound [px]
+} budgetCand_t;
+
+struct budgetRec {
+	ctx_t ctx;			// identity CTM
+	shape_t shp;		// in output space
+	const char *elem, *id;	// element, if to be checked
+	size_t offset;
+	struct budgetRec *next;
+};
+
+static struct {
+	budgetCand_t q[( MAX_FPREC + 1 ) * BUDGET_DEXP];	// quantizations
+	size_t q_num;
+	int q_exp;			// \p exponent the quantizations were set up for
+	int prec, exp, scale;	// configured output settings
+	double upx;			// output space units per pixel
+	budgetCand_t best;	// last search result
+	const shape_t *fmt;	// shape last formatted
+	shape_t tmp;		// per line: shape in output space
+	shape_t simp;		// simplified shape
+	unsigned long fit, over;	// lines or documents within/over budget
+	double err;			// largest error bound chosen
+} bud;
+
+static int budgetCandCmp( const void *a, const void *b )
+{
+	double d = ( (const budgetCand_t *)a )->err - ( (const budgetCand_t *)b )->err;
+	return ( d > 0 ) - ( d < 0 );
+}
+
+/*
+ * Set up the quantizations (precision and \p exponent), ordered by
+ * rounding error. Those which are expected to need no fewer characters
+ * per number than a finer one are dropped, so output size decreases
+ * along the list.
+ */
+static void budgetSetup( void )
+{
+	budgetCand_t all[( MAX_FPREC + 1 ) * BUDGET_DEXP], *c = all;
+	double chars, min = HUGE_VAL;
+	int p, e;
+
+	bud.prec = config.ass_fprec;
+	bud.exp = config.ass_scale_exp;
+	bud.scale = config.ass_scale;
+	bud.upx = ldexp( 1.0, bud.exp - 1 ) / bud.scale;
+	if ( bud.q_exp == bud.exp && bud.q_num )
+		return;
+	for ( p = 0; p <= MAX_FPREC; ++p )
+		for ( e = 0; e < BUDGET_DEXP; ++e, ++c )
+		{
+			c->prec = p;
+			c->dexp = e;
+			c->tol = 0.0;
+			c->err = 0.5 * M_SQRT2 * pow( 10.0, -p ) / ldexp( 1.0, bud.exp + e - 1 );
+		}
+	qsort( all, c - all, sizeof *c, budgetCandCmp );
+	bud.q_num = 0;
+	for ( c = all; c < all + sizeof all / sizeof *all; ++c )
+	{
+		chars = c->prec + c->dexp * log10( 2.0 ) + ( c->prec > 0 );
+		if ( chars < min )
+			bud.q[bud.q_num++] = *c;
+		min = fmin( min, chars );
+	}
+	bud.q_exp = bud.exp;
+}
+
+/*
+ * Switch output settings to candidate c, or back to the configured
+ * ones for NULL.
+ */
+static void budgetApply( const budgetCand_t *c )
+{
+	config.ass_fprec = c ? c->prec : bud.prec;
+	config.ass_scale_exp = bud.exp + ( c ? c->dexp : 0 );
+	config.ass_scale = bud.scale << ( c ? c->dexp : 0 );
+}
+
+static int budgetFmt( const struct budgetRec *r, const budgetCand_t *c )
+{
+	const shape_t *shp = &r->shp;
+
+	if ( c->tol > 0.0 )
+	{
+		if ( 0 != shpSimplify( &bud.simp, shp, c->tol * bud.upx ) )
+			return -1;
+		shp = &bud.simp;
+	}
+	bud.fmt = shp;
+	return fmtShape( &r->ctx, shp );
+}
+
+/*
+ * Output size of the shapes in list r, including line overhead.
+ */
+static unsigned long long budgetCost( const struct budgetRec *r, const budgetCand_t *c )
+{
+	unsigned long long n = 0;
+	unsigned long points = stats.points;
+	int line = 1, layer = config.ass_layer;
+
+	budgetApply( c );
+	for ( ; r; r = r->next )
+	{
+		if ( 0 != budgetFmt( r, c ) || ( line && 0 != fmtLineStart( &r->ctx ) ) )
+		{
+			n = ULLONG_MAX;
+			break;
+		}
+		if ( line )
+		{
+			n += lbuf.len + 6;	// 6: "{\p0}\n"
+			++config.ass_layer;
+		}
+		n += obuf.len;
+		line = ( 1 == config.ass_mode );
+	}
+	budgetApply( NULL );
+	config.ass_layer = layer;
+	stats.points = points;
+	return n;
+}
+
+/*
+ * Find the settings with the smallest error bound that fit the budget.
+ * Output size falls with both rounding error and tolerance, so the
+ * smallest fitting tolerance for each quantization is found walking
+ * a staircase from the finest quantization and largest tolerance.
+ * If nothing fits, go with the coarsest settings.
+ */
+static const budgetCand_t *budgetSearch( const struct budgetRec *r )
+{
+	size_t i = 0, j = BUDGET_TOL_NUM - 1;
+	budgetCand_t c;
+	int found = 0;
+
+	budgetSetup();
+	bud.best = bud.q[bud.q_num - 1];
+	bud.best.tol = budget_tol[j];
+	bud.best.err += bud.best.tol;
+	while ( i < bud.q_num )
+	{
+		c = bud.q[i];
+		c.tol = budget_tol[j];
+		c.err += c.tol;
+		if ( budgetCost( r, &c ) <= config.budget )
+		{
+			if ( !found || c.err < bud.best.err )
+				bud.best = c;
+			found = 1;
+			if ( 0 == j-- )
+				break;
+		}
+		else
+			++i;
+	}
+	if ( found )
+		++bud.fit;
+	else
+		++bud.over;
+	bud.err = fmax( bud.err, bud.best.err );
+	return &bud.best;
+}
+
+static inline int budgetDoc( void )
+{
+	return !config.budget_line || 0 == config.ass_mode;
+}
+
+static int budgetWrite( const struct budgetRec *r, const budgetCand_t *c )
+{
+	int res = 0;
+
+	budgetApply( c );
+	for ( ; r && 0 == res; r = r->next )
+	{
+		res = budgetFmt( r, c ) || limitOutput( obuf.len );
+		if ( 0 != res )
+			break;
+		ass_line( (ctx_t *)&r->ctx, ASS_START );
+		res = emitFragment( obuf.s, obuf.len ) || binShape( &r->ctx, bud.fmt );
+		if ( 0 == res && r->elem )
+			res = verifyRead() || ( budgetDoc()
+				&& verifyReport( &r->ctx, &r->shp, r->elem, r->id, r->offset ) );
+		if ( 1 == config.ass_mode )
+			ass_line( NULL, ASS_CLOSE );
+	}
+	budgetApply( NULL );
+	return res;
+}
+
+/*
+ * Write out shape, transformed to output space, with settings chosen
+ * for the line; or hold it back for the document budget.
+ */
+static int budgetShape( const ctx_t *ctx, const shape_t *shp )
+{
+	struct budgetRec rec, *r = &rec;
+	size_t i;
+	int res = 0;
+
+	if ( budgetDoc() )
+	{
+		if ( NULL == ( r = arenaAlloc( &arena, sizeof *r ) ) )
+			return -1;
+		r->shp = (shape_t){ NULL, 0, 0, &arena };
+	}
+	else
+	{
+		bud.tmp.num = 0;
+		r->shp = bud.tmp;
+	}
+	r->ctx = *ctx;
+	r->ctx.ctm = MTX_UNI;
+	r->ctx.ctm_kind = MTX_KIND_IDENTITY;
+	r->next = NULL;
+	r->elem = r->id = NULL;
+	r->offset = vfy.offset;
+	if ( vfy.cap && r == &rec )
+		r->elem = vfy.elem;
+	else if ( vfy.cap && ( NULL == ( r->elem = arenaStrdup( &arena, vfy.elem ) )
+		|| ( vfy.id && NULL == ( r->id = arenaStrdup( &arena, vfy.id ) ) ) ) )
+		return -1;
+	for ( i = 0; i < shp->num && 0 == res; ++i )
+		res = shpAdd( &r->shp, shp->pt[i].cmd, ctm_apply( ctx, shp->pt[i].v ) );
+	if ( r == &rec )
+	{
+		bud.tmp = rec.shp;
+		return res || budgetWrite( r, budgetSearch( r ) );
+	}
+	if ( 0 != res )
+		return -1;
+	if ( doc.blast )
+		doc.blast->next = r;
+	else
+		doc.brec = r;
+	doc.blast = r;
+	return 0;
+}
+
+/*
+ * Write out the shapes held back for the document budget, and report
+ * the outcome.
+ */
+static int budgetFlush( const char *name )
+{
+	const budgetCand_t *c;
+	unsigned long long n0 = doc.out_bytes;
+	int res = 0;
+
+	if ( !config.budget )
+		return 0;
+	if ( doc.brec )
+	{
+		c = budgetSearch( doc.brec );
+		res = budgetWrite( doc.brec, c );
+		err( ELVL_INFO, 0, "%s: %llu of %llu bytes budget: precision %d, \\p%d, "
+				"tolerance %g px, error <= %g px%s", name, doc.out_bytes - n0, config.budget,
+				c->prec, bud.exp + c->dexp, c->tol, c->err, bud.over ? ", OVER BUDGET" : "" );
+	}
+	else if ( bud.fit + bud.over )
+		err( ELVL_INFO, 0, "%s: %lu lines within %llu bytes budget, %lu over, error <= %g px",
+				name, bud.fit, config.budget, bud.over, bud.err );
+	bud.fit = bud.over = 0;
+	bud.err = 0.0;
+	return res;
+}
+
+
+/************************************************************
+ *	Shape conversion
+ */
+
+static buf_t kbuf;
+
+/*
+ * Memo key for element in watch mode: name and attributes.
+ */
+static const char *markupKey( const nxmlNode_t *node, size_t *len )
+{
+	size_t i;
+	int r;
+
+	kbuf.len = 0;
+	r = bufPut( &kbuf, node->name, strlen( node->name ) + 1 );
+	for ( i = 0; i < node->att_num; ++i )
+	{
+		r |= bufPut( &kbuf, node->att[i].name, strlen( node->att[i].name ) + 1 );
+		r |= bufPut( &kbuf, node->att[i].val, strlen( node->att[i].val ) + 1 );
+	}
+	*len = kbuf.len;
+	return r ? NULL : kbuf.s;
+}
+
+/*
+ * Automatic output settings: pick \p exponent increment and precision
+ * for the fewest characters per number that keep the rounding error
+ * within the pixel tolerance given with -P. Integer coordinates under
+ * a higher \p exponent are preferred, as long as the numbers for the
+ * shape's extent stay within AUTO_MAX_COORD. The exponent is only
+ * changed with a line of its own (mode 1).
+ */
+#define AUTO_MAX_DEXP	8
+#define AUTO_MAX_COORD	1e7
+
+static void autoOutput( const ctx_t *ctx, const shape_t *shp )
+{
+	double m = 0.0, n, e;
+	int d, p, c, best = INT_MAX, bp = MAX_FPREC, bd = 0;
+	vec_t v;
+	size_t i;
+
+	for ( i = 0; i < shp->num; ++i )
+	{
+		v = ctm_apply( ctx, shp->pt[i].v );
+		m = fmax( m, fmax( fabs( v.x ), fabs( v.y ) ) );
+	}
+	for ( d = 0; d <= ( 1 == config.ass_mode ? AUTO_MAX_DEXP : 0 ); ++d )
+	{
+		n = m * config.ass_scale * ldexp( 1.0, d );	// largest number written
+		if ( d && n > AUTO_MAX_COORD )
+			break;
+		for ( p = 0; p <= MAX_FPREC; ++p )
+		{
+			e = 0.5 * M_SQRT2 * pow( 10.0, -p ) / ldexp( 1.0, config.ass_scale_exp + d - 1 );
+			if ( e > config.auto_tol )
+				continue;
+			c = ( n < 10.0 ? 1 : (int)log10( n ) + 1 ) + ( p ? p + 1 : 0 );
+			if ( c < best )
+			{
+				best = c;
+				bp = p;
+				bd = d;
+			}
+			break;
+		}
+	}
+	config.ass_fprec = bp;
+	config.ass_scale_exp += bd;
+	config.ass_scale <<= bd;
+}
+
+/*
+ * Write out shape on the current line, starting a new one if need be.
+ */
+static int emitShape( ctx_t *ctx, const shape_t *shp )
+{
+	int prec = config.ass_fprec, exp = config.ass_scale_exp, scale = config.ass_scale;
+	int res;
+
+	if ( config.budget )
+		return budgetShape( ctx, shp );
+	if ( 0.0 < config.auto_tol )
+		autoOutput( ctx, shp );
+	res = fmtShape( ctx, shp ) || limitOutput( obuf.len );
+	if ( 0 == res )
+	{
+		ass_line( ctx, ASS_START );
+		res = emitFragment( obuf.s, obuf.len ) | binShape( ctx, shp );
+	}
+	if ( 0 == res && vfy.cap )
+		res = verifyRead();
+	config.ass_fprec = prec;
+	config.ass_scale_exp = exp;
+	config.ass_scale = scale;
+	return res;
+}
+
+/*
+ * Expand the stroke of a shape to an outline in output space and
+ * write it out as fill-only shape in stroke color, on a line of its
+ * own in mode 1. The outline is flattened to a tenth of a pixel.
+ */
+static shape_t outline;
+
+static int drawStroke( const ctx_t *ctx, const shape_t *shp )
+{
+	ctx_t sc = *ctx;
+	strokeStyle_t st;
+	mtx_t m = ctx->ctm;
+
+	st.width = ctx->s_width * sqrt( fabs( m.a * m.d - m.b * m.c ) );
+	st.join = ctx->s_join;
+	st.cap = ctx->s_cap;
+	st.miterlimit = ctx->s_miter;
+	st.tol = 0.1;
+	outline.num = 0;
+	if ( 0 != strokeShape( &outline, shp, m, &st ) )
+		return -1;
+	if ( !outline.num )
+		return 0;
+	sc.f_col = ctx->s_col;
+	sc.f_alpha = ctx->s_alpha;
+	sc.f_calpha = ctx->s_calpha;
+	sc.s_width = 0.0;
+	sc.ctm = MTX_UNI;
+	sc.ctm_kind = MTX_KIND_IDENTITY;
+	if ( 1 == config.ass_mode )
+		ass_line( &sc, ASS_CLOSE );
+	return emitShape( &sc, &outline );
+}
+
+/*
+ * Convert shape element and write it out; below a <use> element the
+ * geometry is looked up in, or added to, the <use> cache, path data
+ * and points lists (or, in watch mode, all shapes) are looked up in,
+ * or added to, the memo.
+ */
+static int drawShape( ctx_t *ctx, const nxmlNode_t *node, const geom_t *g )
+{
+	struct useShape *us = NULL, **pus = NULL;
+	const shape_t *shp = &shape;
+	const memoEnt_t *me;
+	const char *src = NULL;
+	size_t len = 0, h = 0;
+	int res = 0, check = 0, filled;
+	ctx_t *stroke = NULL, fc;
+
+	if ( config.stroke_outline && 0.0 < ctx->s_width
+		&& 255 > mixAlpha( ctx->s_alpha, ctx->s_calpha ) )
+	{	// stroke drawn separately, fill without border
+		fc = *ctx;
+		fc.s_width = 0.0;
+		stroke = ctx;
+		ctx = &fc;
+	}
+	if ( !config.memo_cap || stroke || config.budget || 0.0 < config.auto_tol || bin.w.fp
+		|| vfy.fp )
+		;
+	else if ( config.watch )
+		src = markupKey( node, &len );
+	else if ( g->data && NULL != ( src = getStringAttr( node, g->data ) ) )
+		len = strlen( src );
+	if ( src )
+	{
+		h = memoHash( src, len, ctx );
+		if ( NULL != ( me = memoFind( src, len, h, ctx ) ) )
+		{
+			STATS_INC( memo_hits );
+			if ( limitOutput( me->outlen ) )
+				return -1;
+			STATS_ADD( points, me->points );
+			ass_line( ctx, ASS_START );
+			return emitFragment( me->data + me->srclen, me->outlen );
+		}
+		STATS_INC( memo_misses );
+	}
+	if ( doc.use_depth )
+	{
+		pus = &doc.ushape[node->offset % USE_CACHE_SZ];
+		for ( us = *pus; us && us->offset != node->offset; us = us->next )
+			;
+	}
+	if ( us )
+	{
+		STATS_INC( use_hits );
+		shp = &us->shp;
+	}
+	else
+	{
+		shape.num = 0;
+		res = g->fn( node );
+		if ( doc.trunc )
+		{	// points limit: render what we got
+			doc.trunc = 0;
+			STATS_INC( lim_points );
+			res = 0;
+		}
+		if ( doc.abort )	// document limit hit while building it
+			return -1;
+		if ( pus && NULL != ( us = arenaAlloc( &arena, sizeof *us ) )
+			&& 0 == shpCopy( &us->shp, &shape, &arena ) )
+		{
+			STATS_INC( use_misses );
+			us->offset = node->offset;
+			us->next = *pus;
+			*pus = us;
+		}
+	}
+	filled = 255 > mixAlpha( ctx->f_alpha, ctx->f_calpha );
+	if ( !stroke || filled )
+	{	// unfilled shapes are not checked
+		vfy.cap = ( NULL != vfy.fp && filled );
+		vfy.elem = node->name;
+		vfy.id = getStringAttr( node, "id" );
+		vfy.offset = node->offset;
+		check = emitShape( ctx, shp );
+		vfy.cap = 0;
+		if ( 0 != check )
+			return -1;
+		if ( src && 0 == res )
+			memoAdd( src, len, h, ctx, obuf.s, obuf.len, opoints );
+		check = vfy.fp && filled && !( config.budget && budgetDoc() );
+	}
+	if ( stroke )
+		res |= drawStroke( stroke, shp );
+	if ( check && 0 == res )
+		res = verifyShape( ctx, node, g->fn );
+	return res;
+}
+
+
+
+/************************************************************
+ *	Layer output streams
+ *
+ * With a file name template set, the output of each top-level group
+ * (usually an Inkscape layer) goes to a file of its own, named after
+ * the inkscape:label, id or position of the group. Streams stay open
+ * until program exit, groups of the same name share a stream. Each
+ * stream keeps its own ASS layer counter, starting at the counter
+ * value of the document that opened it.
+ */
+
+struct layerOut {
+	char *name;
+	FILE *fp;
+	int ass_layer;		// next ASS layer number
+	struct layerOut *next;
+};
+
+static struct {
+	struct layerOut *list;
+	FILE *of;			// saved main output
+	int ass_layer;		// saved main layer counter
+	int base;			// main layer counter at document start
+	int num;			// top-level groups seen
+} layers;
+
+/*
+ * Build file name from template, replacing the first "%s" with the
+ * layer name; characters unsuitable for file names are replaced.
+ */
+static char *layerFileName( const char *name )
+{
+	const char *t = strstr( config.layer_fmt, "%s" );
+	size_t pre = t - config.layer_fmt, n = strlen( name );
+	char *fn, *p;
+
+	if ( NULL == ( fn = malloc( strlen( config.layer_fmt ) - 2 + n + 1 ) ) )
+		return NULL;
+	memcpy( fn, config.layer_fmt, pre );
+	for ( p = fn + pre; *name; ++name )
+		*p++ = ( isalnum( (unsigned char)*name ) || strchr( "-_.+", *name ) ) ? *name : '_';
+	strcpy( p, t + 2 );
+	return fn;
+}
+
+static struct layerOut *layerOpen( const nxmlNode_t *node )
+{
+	struct layerOut *lo;
+	const char *name;
+	char num[32], *fn;
+
+	++layers.num;
+	if ( NULL == ( name = getStringAttr( node, "inkscape:label" ) )
+		&& NULL == ( name = getStringAttr( node, "id" ) ) )
+	{
+		sprintf( num, "%d", layers.num );
+		name = num;
+	}
+	for ( lo = layers.list; lo; lo = lo->next )
+		if ( 0 == strcmp( lo->name, name ) )
+			return lo;
+	if ( NULL == ( fn = layerFileName( name ) ) )
+		return NULL;
+	if ( NULL == ( lo = calloc( 1, sizeof *lo ) )
+		|| NULL == ( lo->name = strdup( name ) )
+		|| NULL == ( lo->fp = fopen( fn, "w" ) ) )
+	{
+		err( ELVL_FATAL, 0, "fopen '%s': %s", fn, strerror( errno ) );
+	}
+	DPRINT( "layer '%s' writing to file '%s'\n", name, fn );
+	free( fn );
+	lo->ass_layer = layers.base;
+	lo->next = layers.list;
+	layers.list = lo;
+	return lo;
+}
+
+/*
+ * Switch output to, or back from, top-level group stream.
+ */
+static void layerEnter( ctx_t *ctx, const nxmlNode_t *node )
+{
+	struct layerOut *lo = layerOpen( node );
+
+	if ( !lo )
+		return;
+	ass_line( ctx, ASS_CLOSE );
+	layers.of = config.of;
+	layers.ass_layer = config.ass_layer;
+	config.of = lo->fp;
+	config.ass_layer = lo->ass_layer;
+	doc.layer = lo;
+}
+
+static void layerLeave( ctx_t *ctx )
+{
+	ass_line( ctx, ASS_CLOSE );
+	doc.layer->ass_layer = config.ass_layer;
+	config.of = layers.of;
+	config.ass_layer = layers.ass_layer;
+	doc.layer = NULL;
+}
+
+static int layerCloseAll( void )
+{
+	struct layerOut *lo;
+	int res = 0;
+
+	while ( NULL != ( lo = layers.list ) )
+	{
+		layers.list = lo->next;
+		if ( 0 != fclose( lo->fp ) )
+			res = -1;
+		free( lo->name );
+		free( lo );
+	}
+	return res;
+}
+
+/*
+ * Callback function for XML parser
+ */
+static int svg2ass( nxmlEvent_t evt, const nxmlNode_t *node, void *usr )
+{
+	int res = 0, skip = 0;
+	ctx_t *ctx = usr;
+	const geom_t *gfn;
+
+	// style sheet content, either as text or CDATA section
+	if ( doc.in_style && ctx->in_svg
+		&& ( NXML_EVT_TEXT == evt || ( NXML_EVT_OPEN == evt && NXML_TYPE_CDATA == node->type ) ) )
+	{
+		if ( 0 != parseStyleSheet( node->name ) )
+			err( ELVL_ERROR, 0, "style sheet: %s", strerror( errno ) );
+		return 0;
+	}
+	if ( NXML_TYPE_PARENT != node->type
+		&& NXML_TYPE_SELF != node->type
+		&& NXML_TYPE_END != node->type )
+		return 0;
+	STATS_ENTER( STATS_PH_GEOMETRY );
+
+	switch ( evt )
+	{
+	case NXML_EVT_OPEN:
+		if ( 0 == strcasecmp( node->name, "svg" ) )
+		{
+			if ( ctx->in_svg )
+				err( ELVL_WARNING, 0, "nested <svg> element!" );
+			ctx->in_svg++;
+		}
+		if ( !ctx->in_svg )
+			break;
+		IPRINT( "<%s \n", node->name );
+		statsElement( node->name );
+		if ( 0 != ctx_push( ctx ) )
+			err( ELVL_FATAL, 0, "context stack push: %s", strerror( errno ) );
+		if ( TRACE_ON )
+			traceBegin( node->name, getStringAttr( node, "id" ), node->offset );
+
+		if ( limitElement( node ) )
+		{
+			IPRINT( "*limit*\n" );
+			skip = 1;
+		}
+		else if ( 0 == strcasecmp( node->name, "svg" ) )
+		{
+			parseCommon( ctx, node );
+			if ( config.play_w && 1 == stacktop )
+				rootViewport( ctx, node );
+		}
+		else if ( 0 == strcasecmp( node->name, "g" ) )
+		{
+			if ( config.layer_fmt && 2 == stacktop && !doc.use_depth )
+				layerEnter( ctx, node );
+			parseCommon( ctx, node );
+		}
+		else if ( 0 == strcasecmp( node->name, "style" ) )
+		{
+			doc.in_style = ( NXML_TYPE_PARENT == node->type );
+			if ( doc.in_style )
+				doc.xopt.ignore &= ~( NXML_IGN_TEXT | NXML_IGN_CDATA );
+		}
+		else if ( 0 == strcasecmp( node->name, "defs" ) )
+		{
+			parseCommon( ctx, node );
+			ctx->hidden = 1;
+		}
+		else if ( 0 == strcasecmp( node->name, "use" ) )
+		{
+			if ( !ctx->hidden )
+			{
+				parseCommon( ctx, node );
+				res = useElement( ctx, node );
+			}
+		}
+		else if ( NULL != ( gfn = geomFunc( node->name ) ) )
+		{
+			if ( !ctx->hidden )
+			{
+				parseCommon( ctx, node );
+				res = drawShape( ctx, node, gfn );
+			}
+		}
+		else if ( 0 == strcasecmp( node->name, "symbol" ) && doc.use_sym )
+		{
+			doc.use_sym = 0;
+			parseCommon( ctx, node );
+		}
+		else if ( isNonRendered( node->name ) )
+		{
+			IPRINT( "*skipped*\n" );
+			skip = 1;
+		}
+		else
+		{
+			//IPRINT( "*ignored*\n" );
+		}
+		traceSpan( "geometry", 0 );
+		break;
+
+	case NXML_EVT_CLOSE:
+		if ( 0 == strcasecmp( node->name, "style" ) )
+		{
+			doc.in_style = 0;
+			doc.xopt.ignore = XML_IGNORE;
+		}
+		if ( 0 == strcasecmp( node->name, "svg" ) )
+		{
+			if ( !ctx->in_svg )
+				err( ELVL_WARNING, 0, "excess </svg> element!" );
+			ctx->in_svg--;
+		}
+		if ( 0 == ctx_pop( ctx ) )
+			traceEnd();
+		if ( doc.layer && 1 == stacktop )
+			layerLeave( ctx );
+		if ( !ctx->in_svg )
+			break;
+		IPRINT( "/>\n" );
+		break;
+
+	default:
+		break;
+	}
+	if ( 1 == config.ass_mode )
+		ass_line( ctx, ASS_CLOSE );
+	if ( limitDocument() )
+	{
+		STATS_LEAVE();
+		return -1;
+	}
+	if ( 0 != res )
+	{	// report errors, but keep going!
+		err( ELVL_ERROR, 0, "%s: %s", __func__, strerror( errno ) );
+		res = 0;
+	}
+	STATS_LEAVE();
+	return skip ? NXML_SKIP : res;
+}
+
+
+/************************************************************
+ *	Main program stuff
+ */
+
+/*
+ * Gzip compressed input (.svgz) is inflated as it is read, straight
+ * into the document buffer, which grows geometrically. Concatenated
+ * gzip members are read as one, trailing garbage is ignored.
+ */
+#define GZ_MAGIC( b )	( 0x1f == (unsigned char)(b)[0] && 0x8b == (unsigned char)(b)[1] )
+
+#ifdef HAVE_ZLIB
+#define GZ_CHUNK		65536
+
+static int getGzip( char **pbuf, size_t *psz, size_t n, FILE *pf )
+{
+	static unsigned char in[GZ_CHUNK];
+	char *buf = *pbuf;
+	size_t x = 0, sz;
+	int zr, done = 0;
+	z_stream zs;
+
+	memcpy( in, buf, n );
+	memset( &zs, 0, sizeof zs );
+	if ( Z_OK != inflateInit2( &zs, 16 + MAX_WBITS ) )
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	zs.next_in = in;
+	zs.avail_in = n;
+	STATS_ADD( in_gz_bytes, n );
+	for ( ;; )
+	{
+		if ( 0 == zs.avail_in )
+		{
+			if ( 0 == ( n = fread( in, 1, sizeof in, pf ) ) )
+				break;
+			zs.next_in = in;
+			zs.avail_in = n;
+			STATS_ADD( in_gz_bytes, n );
+		}
+		if ( x + 1 >= *psz )
+		{
+			sz = *psz < GZ_CHUNK ? 4 * GZ_CHUNK : 2 * *psz;
+			if ( NULL == ( buf = realloc( buf, sz ) ) )
+			{
+				inflateEnd( &zs );
+				return -1;
+			}
+			*pbuf = buf;
+			*psz = sz;
+		}
+		sz = *psz - x - 1;
+		zs.next_out = (unsigned char *)buf + x;
+		zs.avail_out = sz > UINT_MAX ? UINT_MAX : sz;
+		zr = inflate( &zs, Z_NO_FLUSH );
+		x = (char *)zs.next_out - buf;
+		if ( Z_STREAM_END == zr )
+		{	// next member, if any
+			done = 1;
+			inflateReset( &zs );
+		}
+		else if ( Z_OK == zr || Z_BUF_ERROR == zr )
+			done &= ( 0 == zs.total_out );
+		else if ( !done )
+		{
+			err( ELVL_WARNING, 0, "inflate: %s", zs.msg ? zs.msg : "corrupt input" );
+			inflateEnd( &zs );
+			errno = EINVAL;
+			return -1;
+		}
+		else
+			break;	// trailing garbage
+	}
+	inflateEnd( &zs );
+	if ( !done )
+	{
+		err( ELVL_WARNING, 0, "inflate: unexpected end of input" );
+		errno = EINVAL;
+		return -1;
+	}
+	buf[x++] = '\0';
+	if ( x < *psz && NULL != ( buf = realloc( buf, x ) ) )
+	{
+		*pbuf = buf;
+		*psz = x;
+	}
+	return ferror( pf );
+}
+#endif
+
+static int getFile( char **pbuf, size_t *psz, size_t inc, FILE *pf )
+{
+	size_t x = 0, n;
+	char *buf = *pbuf;
+
+	do
+	{
+		if ( x + inc + 1 >= *psz )
+		{
+			if ( NULL == ( buf = realloc( buf, *psz + inc + 1 ) ) )
+				return -1;
+			*pbuf = buf;
+			*psz += inc + 1;
+		}
+		n = fread( buf + x, 1, inc, pf );
+		if ( 0 == x && 2 <= n && GZ_MAGIC( buf ) )
+		{
+#ifdef HAVE_ZLIB
+			return getGzip( pbuf, psz, n, pf );
+#else
+			err( ELVL_WARNING, 0, "gzip compressed input, but built without zlib" );
+			errno = ENOTSUP;
+			return -1;
+#endif
+		}
+		x += n;
+	}
+	while ( 0 < n );
+	buf[x++] = '\0';
+	if ( x < *psz && NULL != ( buf = realloc( buf, x ) ) )
+	{
+		*pbuf = buf;
+		*psz = x;
+	}
+	return ferror( pf );
+}
+
+// documents aborted by limits
+static int limit_aborts = 0;
+// documents skipped for unreadable input
+static int read_errors = 0;
+
+static int parse( FILE *fp, const char *name )
+{
+	int res;
+	char *svg = NULL;
+	size_t sz = 0;
+	ctx_t ctx;
+
+	statsReset();
+	traceDocument( name );
+	vfy.doc = name;
+	STATS_ENTER( STATS_PH_READ );
+	res = getFile( &svg, &sz, 4000, fp );
+	STATS_LEAVE();
+	if ( 0 != res )
+	{	// corrupt compressed input and the like: skip the document
+		err( ELVL_ERROR, 0, "%s: reading input: %s, document skipped", name, strerror( errno ) );
+		++read_errors;
+		free( svg );
+		return 0;
+	}
+	STATS_ADD( in_bytes, sz ? sz - 1 : 0 );
+	// initialize context
+	arenaReset( &arena );
+	stack = NULL;
+	stacksz = stacktop = 0;
+	memset( &ctx, 0, sizeof ctx );
+	ctx.ctm = MTX_UNI;
+	ctx.ctm_kind = MTX_KIND_IDENTITY;
+	ctx.s_miter = 4.0;
+	ass_line( &ctx, ASS_COMMENT );
+	layers.base = config.ass_layer;
+	layers.num = 0;
+	doc.t0 = statsNow();
+	// do some real work
+	{
+		doc.xopt.arena = &arena;
+		doc.xopt.ignore = XML_IGNORE;
+		STATS_ENTER( STATS_PH_TOKENIZE );
+		if ( nxmlHasElement( svg, "use" ) )
+		{	// keep text, <style> may show up anywhere
+			nxmlOpt_t dopt = { &arena, NXML_IGN_COMMENT | NXML_IGN_PROC };
+			if ( NULL != ( doc.dom = nxmlDomBuild( svg, &dopt ) ) )
+				res = nxmlDomWalk( doc.dom, 0, svg2ass, &ctx );
+			else
+				res = -1;
+		}
+		else
+			res = nxmlParseOpt( svg, svg2ass, &ctx, &doc.xopt );
+		STATS_LEAVE();
 	}
-	// initialize context
-	memset( &ctx, 0, sizeof ctx );
-	ctx.org = VEC_ZERO;
-	ctx.ctm = MTX_UNI;
-	ass_line( &ctx, ASS_COMMENT );
-	// do some real work
-	res = nxmlParse( svg, svg2ass, &ctx );
 	// clean up
+	if ( doc.layer )
+		layerLeave( &ctx );
+	if ( 0 != budgetFlush( name ) && !doc.abort )
+		err( ELVL_ERROR, 0, "%s: writing output: %s", name, strerror( errno ) );
+	if ( vfy.fp )
+		verifyDoc();
 	ass_line( NULL, ASS_CLOSE );
 	while ( 0 == ctx_pop( &ctx ) )
 		;	// in case we've read an incomplete document
+	if ( doc.abort )
+	{
+		err( ELVL_ERROR, 0, "%s: %s limit exceeded, conversion aborted", name, doc.abort );
+		++limit_aborts;
+		res = 0;
+	}
+	if ( stats.lim_points || stats.lim_depth || stats.lim_attrs || stats.lim_uses )
+		err( ELVL_WARNING, 0, "%s: limits applied: %lu shapes truncated, %lu elements "
+				"skipped for depth, %lu for attribute count, %lu <use> elements skipped", name,
+				stats.lim_points, stats.lim_depth, stats.lim_attrs, stats.lim_uses );
+	cssSheetFree( doc.sheet );
+	memset( &doc, 0, sizeof doc );
 	free( svg );
+	stats.arena_high = arena.high;
+	stats.arena_cap = arena.cap;
+	stats.memo_bytes = memo.bytes;
+	statsPrint( stderr, config.stats_fmt, name );
 	return res;
 }
 
+/*
+ * Parse a byte count argument of option opt; exits on error.
+ */
+static unsigned long long sizeArg( int opt, const char *arg )
+{
+	char *end;
+	double v = strtod( arg, &end );
+
+	if ( end == arg || *end || !( 0.0 <= v && v < (double)ULLONG_MAX ) )
+		err( ELVL_FATAL, 1, "argument for option -%c out of range", opt );
+	return v;
+}
+
+/*
+ * Parse resource limits, given as comma separated name=value list.
+ */
+static int parseLimits( const char *arg )
+{
+	const char *s = arg;
+	char name[8];
+	double v;
+	int n;
+
+	while ( 2 == sscanf( s, " %7[a-z] = %lf%n", name, &v, &n ) && 0 <= v )
+	{
+		if ( 0 == strcmp( name, "points" ) )
+			config.lim.points = v;
+		else if ( 0 == strcmp( name, "bytes" ) )
+			config.lim.bytes = v;
+		else if ( 0 == strcmp( name, "depth" ) )
+			config.lim.depth = v;
+		else if ( 0 == strcmp( name, "attrs" ) )
+			config.lim.attrs = v;
+		else if ( 0 == strcmp( name, "uses" ) )
+			config.lim.uses = v;
+		else if ( 0 == strcmp( name, "time" ) )
+			config.lim.time = v;
+		else
+			return -1;
+		s += n;
+		if ( ',' != *s )
+			break;
+		++s;
+	}
+	return *s ? -1 : 0;
+}
+
+/*
+ * Convert file again whenever it changes; does not return.
+ */
+static void watchFile( const char *fname, int layer0, int nfiles )
+{
+	watch_t w;
+	FILE *ifp;
+	double t;
+
+	if ( !fname || 1 != nfiles || 0 == strcmp( "-", fname ) || !config.of_name
+		|| config.layer_fmt || bin.w.fp || vfy.fp )
+		err( ELVL_FATAL, 1, "option -W requires a single input file and -o, and excludes -G, -d and -V" );
+	if ( 0 != watchOpen( &w, fname ) )
+		err( ELVL_FATAL, 0, "watching '%s': %s", fname, strerror( errno ) );
+	if ( 0 != fflush( config.of ) )
+		err( ELVL_FATAL, 0, "writing '%s': %s", config.of_name, strerror( errno ) );
+	memoSweep();
+	err( ELVL_INFO, 0, "watching '%s'", fname );
+	for ( ;; )
+	{
+		if ( 0 != watchWait( &w ) )
+			err( ELVL_FATAL, 0, "watching '%s': %s", fname, strerror( errno ) );
+		t = statsNow();
+		if ( NULL == freopen( config.of_name, "w", config.of ) )
+			err( ELVL_FATAL, 0, "fopen '%s': %s", config.of_name, strerror( errno ) );
+		if ( NULL == ( ifp = fopen( fname, "r" ) ) )
+		{	// may be gone for a moment while being saved
+			err( ELVL_WARNING, 0, "fopen '%s': %s", fname, strerror( errno ) );
+			continue;
+		}
+		config.ass_layer = layer0;
+		if ( 0 != parse( ifp, fname ) )
+			err( ELVL_ERROR, 0, "parsing file '%s'", fname );
+		fclose( ifp );
+		if ( 0 != fflush( config.of ) )
+			err( ELVL_FATAL, 0, "writing '%s': %s", config.of_name, strerror( errno ) );
+		memoSweep();
+		err( ELVL_INFO, 0, "'%s' converted in %.1f ms, %lu of %lu shapes reused",
+				fname, ( statsNow() - t ) * 1e3, stats.memo_hits,
+				stats.memo_hits + stats.memo_misses );
+	}
+}
+
 static int usage( const char *progname, int version_only )
 {
 	char *p;
@@ -1184,6 +3341,46 @@ static int usage( const char *progname, int version_only )
 		"  -v Print version info and exit.\n"
 		"  -o file\n"
 		"     Write output to file; default: write to stdout.\n"
+		"  -d file\n"
+		"     Additionally write all shapes to file in a binary, memory mappable format,\n"
+		"     see assbin.h; the reader there iterates shapes without text parsing.\n"
+		"  -V file\n"
+		"     Check each filled shape written against its exact geometry, rasterized\n"
+		"     anti-aliased as by the renderer; write IoU, area difference [px^2] and\n"
+		"     Hausdorff distance [px] per shape to file, a summary to stderr.\n"
+		"  -t file\n"
+		"     Write a per element trace in Chrome trace-event JSON format to file.\n"
+		"  -X fmt\n"
+		"     Print per file conversion statistics to stderr, fmt is one of txt, json\n"
+		"     or none; default: none\n"
+		"  -M bytes\n"
+		"     Arena block size for per document allocations; default: 65536\n"
+		"     Presize to the reported arena high-water mark for recurring workloads.\n"
+		"  -G template\n"
+		"     Write the output of each top-level group (Inkscape layer) to a file of its\n"
+		"     own, named by replacing %%s in template with the group's inkscape:label,\n"
+		"     id or position. Layer numbering (-L) is maintained per file.\n"
+		"  -l name=value[,...]\n"
+		"     Resource limits per document, 0 for none (default): points per shape\n"
+		"     (shape truncated), depth of element nesting, attrs per element and <use>\n"
+		"     elements rendered as uses (element skipped), output bytes and time in\n"
+		"     seconds (conversion aborted, exit status %d).\n"
+		"     Example: -l points=100000,depth=64,attrs=200,uses=10000,bytes=1e8,time=10\n"
+		"  -W\n"
+		"     Watch mode: after converting the input file, wait for it to change and\n"
+		"     convert it again, rewriting the output file given with -o. Shapes whose\n"
+		"     markup and transformation did not change are not converted again; the\n"
+		"     memory used for this grows with the document, unless limited with -C.\n"
+		"     Every shape is converted again with -k, -b, -B or -P. Takes a single\n"
+		"     input file, excludes -G, -d and -V. Stop with Ctrl-C.\n"
+		"  -C bytes\n"
+		"     Memory limit for remembering formatted path and points data, reused for\n"
+		"     repeated data under the same transformation; 0 disables; default: %lu,\n"
+		"     none in watch mode.\n"
+		, EXIT_LIMIT
+		, DFLT_MEMO_CAP
+	);
+	fprintf( stderr,
 		"ASS Options:\n"
 		"  -a num\n"
 		"     ASS mode, 0 = single draw command per file, 1 = one line per shape; default: 1\n"
@@ -1205,6 +3402,22 @@ static int usage( const char *progname, int version_only )
 		"     ASS dialog actor name; default: empty\n"
 		"  -T string\n"
 		"     ASS dialog style name; default: Default\n"
+		"  -r WxH\n"
+		"     Map the SVG viewBox (or width and height) to a PlayResX/PlayResY of W x H,\n"
+		"     following preserveAspectRatio, so no pre-scaled SVG is needed; 0 turns it\n"
+		"     off; default: off, output in SVG user units.\n"
+		"  -b bytes, -B bytes\n"
+		"     Output size budget per document (-b) or per dialogue line (-B), 0 for none.\n"
+		"     Output precision, \\p scale and line simplification are chosen for the\n"
+		"     smallest error that fits; the outcome is reported on stderr.\n"
+		"  -P tol\n"
+		"     Choose \\p scale and precision per line from the shape's size, for the\n"
+		"     shortest numbers within tol pixels rounding error, preferring integer\n"
+		"     coordinates scaled as with -s; 0 turns it off; default: off.\n"
+		"  -k\n"
+		"     Expand strokes to outlines, drawn as separate fill-only shapes following\n"
+		"     stroke-linejoin, stroke-linecap and stroke-miterlimit. Default: render\n"
+		"     strokes as ASS borders, which are always round and drawn on both sides.\n"
 		"Experimental:\n"
 		"  -p num\n"
 		"     Set ASS draw mode scaling. This only affects the ASS \\p<num> tags in the\n"
@@ -1223,11 +3436,35 @@ static int usage( const char *progname, int version_only )
 }
 
 
+static void binFinish( void )
+{
+	if ( 0 != assbinClose( &bin.w ) )
+		err( ELVL_ERROR, 0, "writing binary export: %s", strerror( errno ) );
+	free( bin.xy );
+	free( bin.cmd );
+}
+
+static void verifyFinish( void )
+{
+	if ( 0 != fclose( vfy.fp ) )
+		err( ELVL_ERROR, 0, "writing check file: %s", strerror( errno ) );
+	shpFree( &vfy.ref );
+	shpFree( &vfy.out );
+	verifyFree();
+}
+
+static void traceFinish( void )
+{
+	if ( 0 != traceClose() )
+		err( ELVL_ERROR, 0, "writing trace: %s", strerror( errno ) );
+}
+
 int main( int argc, char** argv )
 {
 	int nfiles = 0;
-	int opt;
-	const char *ostr = "-:a:e:p:s:z:f:ho:vA:E:L:S:T:";
+	int opt, layer0 = 0;
+	const char *last = NULL;
+	const char *ostr = "-:a:b:d:e:p:r:s:z:f:hkl:o:t:vA:B:C:E:G:L:M:P:S:T:V:WX:";
 	FILE *ifp;
 
 	config.of = stdout;
@@ -1238,11 +3475,13 @@ int main( int argc, char** argv )
 		{
 		case 1:
 			DPRINT( "reading from file '%s'\n", optarg );
+			last = optarg;
+			layer0 = config.ass_layer;
 			if ( 0 == strcmp( "-", optarg ) )
 				ifp = stdin;
 			else if ( NULL == ( ifp = fopen( optarg, "r" ) ) )
 				err( ELVL_FATAL, 0, "fopen '%s': %s", optarg, strerror( errno ) );
-			if ( 0 != parse( ifp ) )
+			if ( 0 != parse( ifp, optarg ) )
 				err( ELVL_FATAL, 0, "parsing file '%s'", optarg );
 			++nfiles;
 			break;
@@ -1257,6 +3496,23 @@ int main( int argc, char** argv )
 			if ( 1 > config.ass_scale_exp )
 				err( ELVL_FATAL, 1, "argument for option -p out of range" );
 			break;
+		case 'b':
+		case 'B':
+			config.budget = sizeArg( opt, optarg );
+			config.budget_line = ( 'B' == opt );
+			break;
+		case 'P':
+			config.auto_tol = atof( optarg );
+			if ( 0.0 > config.auto_tol )
+				err( ELVL_FATAL, 1, "argument for option -P out of range" );
+			break;
+		case 'r':
+			if ( 0 == strcmp( optarg, "0" ) )
+				config.play_w = config.play_h = 0.0;
+			else if ( 2 != sscanf( optarg, "%lfx%lf", &config.play_w, &config.play_h )
+				|| 1.0 > config.play_w || 1.0 > config.play_h )
+				err( ELVL_FATAL, 1, "invalid argument for option -r: '%s'", optarg );
+			break;
 		case 's':
 			config.ass_scale_exp = atoi( optarg );
 			if ( 1 > config.ass_scale_exp )
@@ -1275,6 +3531,29 @@ int main( int argc, char** argv )
 			DPRINT( "writing to file '%s'\n", optarg );
 			if ( NULL == ( config.of = fopen( optarg, "w" ) ) )
 				err( ELVL_FATAL, 0, "fopen '%s': %s", optarg, strerror( errno ) );
+			config.of_name = optarg;
+			break;
+		case 'd':
+			if ( bin.w.fp )
+				err( ELVL_FATAL, 1, "option -d specified more than once" );
+			if ( 0 != assbinCreate( &bin.w, optarg ) )
+				err( ELVL_FATAL, 0, "fopen '%s': %s", optarg, strerror( errno ) );
+			atexit( binFinish );
+			break;
+		case 'V':
+			if ( vfy.fp )
+				err( ELVL_FATAL, 1, "option -V specified more than once" );
+			if ( NULL == ( vfy.fp = fopen( optarg, "w" ) ) )
+				err( ELVL_FATAL, 0, "fopen '%s': %s", optarg, strerror( errno ) );
+			fputs( "document\telement\tid\toffset\tiou\tdiff\tarea_ref\tarea_out\thausdorff\n", vfy.fp );
+			atexit( verifyFinish );
+			break;
+		case 't':
+			if ( TRACE_ON )
+				err( ELVL_FATAL, 1, "option -t specified more than once" );
+			if ( 0 != traceOpen( optarg ) )
+				err( ELVL_FATAL, 0, "fopen '%s': %s", optarg, strerror( errno ) );
+			atexit( traceFinish );
 			break;
 		case 'h':
 			usage( argv[0], 0 );
@@ -1293,12 +3572,50 @@ int main( int argc, char** argv )
 		case 'L':
 			config.ass_layer = atoi( optarg );
 			break;
+		case 'C':
+			config.memo_cap = sizeArg( opt, optarg );
+			config.memo_cap_set = 1;
+			memoClear();
+			break;
+		case 'l':
+			if ( 0 != parseLimits( optarg ) )
+				err( ELVL_FATAL, 1, "invalid argument for option -l: '%s'", optarg );
+			break;
+		case 'W':
+			config.watch = 1;
+			break;
+		case 'k':
+			config.stroke_outline = 1;
+			break;
+		case 'G':
+			if ( !strstr( optarg, "%s" ) )
+				err( ELVL_FATAL, 1, "argument for option -G must contain %%s" );
+			config.layer_fmt = optarg;
+			break;
+		case 'M':
+			config.arena_blk = sizeArg( opt, optarg );
+			if ( 1 > config.arena_blk )
+				err( ELVL_FATAL, 1, "argument for option -M out of range" );
+			arenaFree( &arena );
+			arenaInit( &arena, config.arena_blk );
+			break;
 		case 'S':
 			config.ass_start = optarg;
 			break;
 		case 'T':
 			config.ass_style = optarg;
 			break;
+		case 'X':
+			if ( 0 == strcasecmp( optarg, "txt" ) )
+				config.stats_fmt = STATS_FMT_TEXT;
+			else if ( 0 == strcasecmp( optarg, "json" ) )
+				config.stats_fmt = STATS_FMT_JSON;
+			else if ( 0 == strcasecmp( optarg, "none" ) )
+				config.stats_fmt = STATS_FMT_NONE;
+			else
+				err( ELVL_FATAL, 1, "argument for option -X out of range" );
+			stats.enabled = ( STATS_FMT_NONE != config.stats_fmt ) || TRACE_ON;
+			break;
 		case ':':
 			err( ELVL_FATAL, 1, "missing argument for option '%c'", optopt );
 			break;
@@ -1307,17 +3624,33 @@ int main( int argc, char** argv )
 			err( ELVL_FATAL, 1, "unrecognized option '%c'", optopt );
 			break;
 		}
+		if ( config.budget && budgetDoc() && config.layer_fmt )
+			err( ELVL_FATAL, 1, "option -b excludes -G, use -B" );
 	}
 
 	if ( !nfiles )
 	{
 		DPRINT( "reading from <stdin>\n" );
-		if ( 0 != parse( stdin ) )
+		if ( 0 != parse( stdin, "<stdin>" ) )
 			err( ELVL_FATAL, 0, "parsing <stdin>" );
 		++nfiles;
 	}
 	DPRINT( "%d file%s processed\n", nfiles, nfiles == 1 ? "" : "s" );
-	exit( EXIT_SUCCESS );
+	if ( config.watch )
+		watchFile( last, layer0, nfiles );
+	arenaFree( &arena );
+	shpFree( &shape );
+	shpFree( &outline );
+	strokeFree();
+	memoClear();
+	free( obuf.s );
+	free( lbuf.s );
+	shpFree( &bud.tmp );
+	shpFree( &bud.simp );
+	free( kbuf.s );
+	if ( 0 != layerCloseAll() )
+		err( ELVL_FATAL, 0, "writing layer output: %s", strerror( errno ) );
+	exit( read_errors ? EXIT_FAILURE : limit_aborts ? EXIT_LIMIT : EXIT_SUCCESS );
 }
 
 /* EOF */
@@ -10,6 +10,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <ctype.h>
@@ -74,7 +75,9 @@ static char *trim( char *str )
 	return str;
 }
 
-static inline char *parseAttrib( char *p, nxmlNode_t *node )
+#define ATT_SZ_INC	50
+
+static inline char *parseAttrib( char *p, nxmlNode_t *node, arena_t *arena )
 {
 	char *m = p;
 	char *ns, *ne, *vs, *ve;
@@ -112,11 +115,15 @@ static inline char *parseAttrib( char *p, nxmlNode_t *node )
 		if ( node->att_num >= node->att_sz )
 		{
 			void *p;
-			p = realloc( node->att, sizeof *node->att * ( node->att_sz + 50 ) );
+			size_t sz = sizeof *node->att * node->att_sz;
+			if ( arena )
+				p = arenaGrow( arena, node->att, sz, sz + sizeof *node->att * ATT_SZ_INC );
+			else
+				p = realloc( node->att, sz + sizeof *node->att * ATT_SZ_INC );
 			if ( !p )
 				break;	// TODO: error handling!
 			node->att = p;
-			node->att_sz += 50;
+			node->att_sz += ATT_SZ_INC;
 		}
 		node->att[node->att_num].name = ns;
 		node->att[node->att_num].val = vs;
@@ -125,7 +132,7 @@ static inline char *parseAttrib( char *p, nxmlNode_t *node )
 	return m;
 }
 
-static inline char *parseMarkup( char *p, nxmlNode_t *node )
+static inline char *parseMarkup( char *p, nxmlNode_t *node, arena_t *arena )
 {
 	int i;
 	char *m = p;
@@ -153,7 +160,7 @@ static inline char *parseMarkup( char *p, nxmlNode_t *node )
 		while ( is_namechar( *m ) )
 			++m;
 		e = m;
-		m = parseAttrib( m, node );
+		m = parseAttrib( m, node, arena );
 		while ( *m && '>' != *m )
 		{	// skip any broken attribute garbage!
 			// TODO: match quotes?
@@ -200,6 +207,95 @@ static inline char *parseMarkup( char *p, nxmlNode_t *node )
 	return m;
 }
 
+static inline const char *skipPast( const char *m, const char *end )
+{
+	const char *e = strstr( m, end );
+	return e ? e + strlen( end ) : m + strlen( m );
+}
+
+/*
+ * Fast scan for the end tag matching an already opened element,
+ * without attribute parsing and without modifying the buffer.
+ * Returns pointer to the '<' of the end tag, or to the terminating
+ * NUL, if there is none.
+ */
+static char *skipContent( char *m )
+{
+	size_t depth = 1;
+	int quot;
+
+	while ( NULL != ( m = strchr( m, '<' ) ) )
+	{
+		if ( '/' == m[1] )
+		{
+			if ( 0 == --depth )
+				return m;
+			m += 2;
+		}
+		else if ( 0 == strncmp( m + 1, "!--", 3 ) )
+			m = (char *)skipPast( m + 4, "-->" );
+		else if ( 0 == strncmp( m + 1, "![CDATA[", 8 ) )
+			m = (char *)skipPast( m + 9, "]]>" );
+		else if ( '?' == m[1] )
+			m = (char *)skipPast( m + 2, "?>" );
+		else if ( '!' == m[1] )
+			m = (char *)skipPast( m + 2, ">" );
+		else
+		{	// start tag; quoted attribute values may contain '>'
+			for ( ++m, quot = 0; *m && ( quot || '>' != *m ); ++m )
+			{
+				if ( quot == *m )
+					quot = 0;
+				else if ( !quot && is_quot( *m ) )
+					quot = *m;
+			}
+			if ( !*m )
+				break;
+			if ( '/' != m[-1] )
+				++depth;
+			++m;
+		}
+	}
+	return m;
+}
+
+/*
+ * Fast scan for a start tag of element name, compared case
+ * insensitively, skipping comments, CDATA sections, processing
+ * instructions and declarations; the buffer is not modified.
+ */
+int nxmlHasElement( const char *buf, const char *name )
+{
+	size_t n = strlen( name );
+	const char *m = buf;
+	int quot;
+
+	while ( NULL != ( m = strchr( m, '<' ) ) )
+	{
+		if ( 0 == strncmp( m + 1, "!--", 3 ) )
+			m = skipPast( m + 4, "-->" );
+		else if ( 0 == strncmp( m + 1, "![CDATA[", 8 ) )
+			m = skipPast( m + 9, "]]>" );
+		else if ( '?' == m[1] )
+			m = skipPast( m + 2, "?>" );
+		else if ( '!' == m[1] )
+			m = skipPast( m + 2, ">" );
+		else if ( 0 == strncasecmp( m + 1, name, n ) && m[n + 1] && !is_namechar( m[n + 1] ) )
+			return 1;
+		else
+		{	// any other tag; quoted attribute values may contain '>'
+			for ( ++m, quot = 0; *m && ( quot || '>' != *m ); ++m )
+			{
+				if ( quot == *m )
+					quot = 0;
+				else if ( !quot && is_quot( *m ) )
+					quot = *m;
+			}
+		}
+	}
+	return 0;
+}
+
 // internal parser states
 enum state {
 	ST_BEGIN = 0,
@@ -210,11 +306,23 @@ enum state {
 };
 
 int nxmlParse( char *buf, nxmlCb_t cb, void *usr )
+{
+	return nxmlParseOpt( buf, cb, usr, NULL );
+}
+
+int nxmlParseOpt( char *buf, nxmlCb_t cb, void *usr, const nxmlOpt_t *opt )
 {
 	int res = 0;
 	char *p, *m = buf;
 	enum state state = ST_BEGIN;
 	nxmlNode_t node;
+	arena_t *arena = opt ? opt->arena : NULL;
+	static const unsigned ign[] = {
+		[NXML_TYPE_COMMENT] = NXML_IGN_COMMENT,
+		[NXML_TYPE_CDATA] = NXML_IGN_CDATA,
+		[NXML_TYPE_PROC] = NXML_IGN_PROC,
+		[NXML_TYPE_DOCTYPE] = NXML_IGN_PROC,
+	};
 
 	memset( &node, 0, sizeof node );
 
@@ -238,28 +346,41 @@ int nxmlParse( char *buf, nxmlCb_t cb, void *usr )
 			break;
 		case ST_CONTENT:
 			m = strchr( p, '<' );
+			state = m ? ST_MARKUP : ST_END;
 			if ( m )
 				*m++ = '\0';
+			if ( opt && ( opt->ignore & NXML_IGN_TEXT ) )
+				break;
 			trim( p );
 			if ( *p )
 			{
+				node.offset = p - buf;
 				node.type = NXML_TYPE_CONTENT;
 				node.name = p;
 				res = cb( NXML_EVT_TEXT, &node, usr );
 			}
-			state = m ? ST_MARKUP : ST_END;
 			break;
 		case ST_MARKUP:
-			m = parseMarkup( p, &node );
-			if ( NXML_TYPE_EMPTY != node.type )
+			node.offset = p - 1 - buf;
+			m = parseMarkup( p, &node, arena );
+			state = ST_CONTENT;
+			if ( NXML_TYPE_EMPTY == node.type
+				|| ( opt && ( opt->ignore & ign[node.type] ) ) )
+				break;
+			if ( NXML_TYPE_END != node.type )
+				res = cb( NXML_EVT_OPEN, &node, usr );
+			node.att_num = 0;
+			if ( NXML_SKIP == res )
 			{
-				if ( NXML_TYPE_END != node.type )
-					res = cb( NXML_EVT_OPEN, &node, usr );
-				node.att_num = 0;
-				if ( 0 == res && NXML_TYPE_PARENT != node.type )
-					res = cb( NXML_EVT_CLOSE, &node, usr );
+				res = 0;
+				if ( NXML_TYPE_PARENT == node.type && '\0' != *( m = skipContent( m ) ) )
+				{
+					state = ST_MARKUP;
+					++m;
+				}
 			}
-			state = ST_CONTENT;
+			if ( 0 == res && NXML_TYPE_PARENT != node.type )
+				res = cb( NXML_EVT_CLOSE, &node, usr );
 			break;
 		case ST_STOP:	/* no break */
 		default:
@@ -270,7 +391,297 @@ int nxmlParse( char *buf, nxmlCb_t cb, void *usr )
 		if ( res )
 			state = ST_STOP;
 	}
+	if ( !arena )
+		free( node.att );
+	return res;
+}
+
+
+/************************************************************
+ *	Compact DOM
+ */
+
+typedef struct {
+	nxmlDom_t *dom;
+	arena_t *arena;
+	unsigned open;		// innermost open element
+} build_t;
+
+static inline unsigned strHash( const char *s )
+{
+	unsigned h = 2166136261u;
+	while ( *s )
+		h = ( h ^ (unsigned char)*s++ ) * 16777619u;
+	return h;
+}
+
+static const char **findName( const nxmlDom_t *dom, const char *name )
+{
+	size_t i = strHash( name ) & ( dom->names_sz - 1 );
+
+	while ( dom->names[i] && 0 != strcmp( dom->names[i], name ) )
+		i = ( i + 1 ) & ( dom->names_sz - 1 );
+	return &dom->names[i];
+}
+
+/*
+ * Return the interned copy of name, adding it if necessary.
+ */
+static const char *intern( build_t *b, const char *name )
+{
+	nxmlDom_t *dom = b->dom;
+	const char **slot;
+
+	if ( 2 * ( dom->names_num + 1 ) > dom->names_sz )
+	{	// rehash at half load
+		nxmlDom_t old = *dom;
+		size_t i;
+		dom->names_sz = old.names_sz ? 2 * old.names_sz : 64;
+		if ( NULL == ( dom->names = arenaAlloc( b->arena, dom->names_sz * sizeof *dom->names ) ) )
+			return NULL;
+		memset( dom->names, 0, dom->names_sz * sizeof *dom->names );
+		for ( i = 0; i < old.names_sz; ++i )
+			if ( old.names[i] )
+				*findName( dom, old.names[i] ) = old.names[i];
+	}
+	slot = findName( dom, name );
+	if ( !*slot )
+	{
+		*slot = name;
+		++dom->names_num;
+	}
+	return *slot;
+}
+
+static int buildCb( nxmlEvent_t evt, const nxmlNode_t *node, void *usr )
+{
+	build_t *b = usr;
+	nxmlDom_t *dom = b->dom;
+	nxmlDomNode_t *n, *p;
+	unsigned i;
+	size_t a;
+
+	if ( NXML_EVT_CLOSE == evt )
+	{
+		if ( NXML_TYPE_END == node->type && b->open )
+		{	// end of element: pop
+			n = &dom->node[b->open];
+			b->open = n->parent;
+			n->end = dom->nnode;
+		}
+		return 0;
+	}
+	if ( NXML_EVT_OPEN != evt && NXML_EVT_TEXT != evt )
+		return 0;
+	i = dom->nnode++;
+	n = &dom->node[i];
+	p = &dom->node[b->open];
+	memset( n, 0, sizeof *n );
+	n->type = node->type;
+	n->offset = node->offset;
+	n->parent = b->open;
+	n->end = i + 1;
+	n->name = node->name;
+	if ( NXML_TYPE_PARENT == node->type || NXML_TYPE_SELF == node->type )
+	{
+		if ( NULL == ( n->name = intern( b, node->name ) ) )
+			return -1;
+		n->att = dom->natt;
+		n->att_num = node->att_num;
+		for ( a = 0; a < node->att_num; ++a )
+		{
+			dom->att[dom->natt].name = intern( b, node->att[a].name );
+			dom->att[dom->natt++].val = node->att[a].val;
+		}
+	}
+	// link to parent; while open, end holds the last child
+	if ( p->child )
+		dom->node[p->end].next = i;
+	else
+		p->child = i;
+	p->end = i;
+	if ( NXML_TYPE_PARENT == node->type )
+	{
+		n->end = 0;
+		b->open = i;
+	}
+	return 0;
+}
+
+/*
+ * Build DOM from buf, which is modified in place and has to outlive
+ * the DOM. All memory is taken from opt->arena, which is mandatory.
+ */
+nxmlDom_t *nxmlDomBuild( char *buf, const nxmlOpt_t *opt )
+{
+	build_t b;
+	const char *p;
+	size_t nmark = 0, neq = 0;
+
+	if ( !opt || !opt->arena )
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+	// the number of '<' and '=' puts an upper bound on nodes and attributes
+	for ( p = buf; *p; ++p )
+	{
+		nmark += ( '<' == *p );
+		neq += ( '=' == *p );
+	}
+	if ( !( opt->ignore & NXML_IGN_TEXT ) )
+		nmark *= 2;
+	b.arena = opt->arena;
+	b.open = 0;
+	if ( NULL == ( b.dom = arenaAlloc( b.arena, sizeof *b.dom ) )
+		|| NULL == ( b.dom->node = arenaAlloc( b.arena, ( nmark + 2 ) * sizeof *b.dom->node ) )
+		|| NULL == ( b.dom->att = arenaAlloc( b.arena, ( neq + 1 ) * sizeof *b.dom->att ) ) )
+		return NULL;
+	b.dom->natt = b.dom->names_sz = b.dom->names_num = 0;
+	b.dom->names = NULL;
+	memset( &b.dom->node[0], 0, sizeof b.dom->node[0] );
+	b.dom->node[0].type = NXML_TYPE_EMPTY;
+	b.dom->node[0].name = "";
+	b.dom->nnode = 1;
+	if ( 0 != nxmlParseOpt( buf, buildCb, &b, opt ) )
+		return NULL;
+	// close elements left open by a truncated document
+	while ( b.open )
+	{
+		b.dom->node[b.open].end = b.dom->nnode;
+		b.open = b.dom->node[b.open].parent;
+	}
+	b.dom->node[0].end = b.dom->nnode;
+	return b.dom;
+}
+
+/*
+ * Look up interned name; returns NULL if name does not occur at all.
+ */
+const char *nxmlDomName( const nxmlDom_t *dom, const char *name )
+{
+	return dom->names_sz ? *findName( dom, name ) : NULL;
+}
+
+/*
+ * Attribute value by interned name, NULL if not present.
+ */
+const char *nxmlDomAttr( const nxmlDom_t *dom, unsigned n, const char *iname )
+{
+	const nxmlDomNode_t *np = &dom->node[n];
+	unsigned a;
+
+	for ( a = np->att; a < np->att + np->att_num; ++a )
+		if ( dom->att[a].name == iname )
+			return dom->att[a].val;
+	return NULL;
+}
+
+static nxmlEvent_t replay( const nxmlDom_t *dom, unsigned i, nxmlEvent_t evt, nxmlNode_t *node )
+{
+	const nxmlDomNode_t *n = &dom->node[i];
+
+	node->name = n->name;
+	node->offset = n->offset;
+	node->error = 0;
+	node->type = n->type;
+	node->att = &dom->att[n->att];
+	node->att_num = n->att_num;
+	if ( NXML_EVT_CLOSE == evt )
+	{	// like the parser, report no attributes for CLOSE
+		if ( NXML_TYPE_PARENT == n->type )
+			node->type = NXML_TYPE_END;
+		node->att_num = 0;
+	}
+	return evt;
+}
+
+/*
+ * Deliver the events of subtree root (0: whole document, including
+ * BEGIN and END) to cb, as nxmlParse() would; NXML_SKIP works alike.
+ */
+int nxmlDomWalk( const nxmlDom_t *dom, unsigned root, nxmlCb_t cb, void *usr )
+{
+	int res = 0;
+	unsigned i, open, stop, end = dom->node[root].end;
+	nxmlNode_t node;
+
+	memset( &node, 0, sizeof node );
+	if ( !root )
+	{
+		node.type = NXML_TYPE_EMPTY;
+		node.name = "";
+		if ( 0 != ( res = cb( NXML_EVT_BEGIN, &node, usr ) ) )
+			return res;
+	}
+	stop = open = root ? dom->node[root].parent : 0;
+	for ( i = root ? root : 1; i < end; )
+	{
+		const nxmlDomNode_t *n = &dom->node[i];
+		nxmlEvent_t evt = NXML_TYPE_CONTENT == n->type ? NXML_EVT_TEXT : NXML_EVT_OPEN;
+		int skip = 0;
+
+		// close elements whose subtree ends here
+		for ( ; open != stop && dom->node[open].end <= i; open = dom->node[open].parent )
+			if ( 0 != ( res = cb( replay( dom, open, NXML_EVT_CLOSE, &node ), &node, usr ) ) )
+				return res;
+		res = cb( replay( dom, i, evt, &node ), &node, usr );
+		if ( NXML_SKIP == res )
+		{
+			skip = 1;
+			res = 0;
+		}
+		else if ( 0 != res )
+			return res;
+		if ( NXML_TYPE_PARENT == n->type )
+		{
+			open = i;
+			i = skip ? n->end : i + 1;
+			continue;
+		}
+		if ( NXML_EVT_OPEN == evt
+			&& 0 != ( res = cb( replay( dom, i, NXML_EVT_CLOSE, &node ), &node, usr ) ) )
+			return res;
+		++i;
+	}
+	for ( ; open != stop; open = dom->node[open].parent )
+		if ( 0 != ( res = cb( replay( dom, open, NXML_EVT_CLOSE, &node ), &node, usr ) ) )
+			return res;
+	if ( !root )
+	{
+		node.type = NXML_TYPE_EMPTY;
+		node.name = "";
+		node.att_num = 0;
+		res = cb( NXML_EVT_END, &node, usr );
+	}
 	return res;
 }
 
+/*
+ * Pre-order iteration over the descendants of root.
+ */
+void nxmlDomIterInit( nxmlDomIter_t *it, const nxmlDom_t *dom, unsigned root )
+{
+	it->dom = dom;
+	it->i = root + 1;
+	it->end = dom->node[root].end;
+	it->last = root;
+}
+
+const nxmlDomNode_t *nxmlDomIterNext( nxmlDomIter_t *it )
+{
+	if ( it->i >= it->end )
+		return NULL;
+	it->last = it->i++;
+	return &it->dom->node[it->last];
+}
+
+/*
+ * Do not descend into the node last returned.
+ */
+void nxmlDomIterSkip( nxmlDomIter_t *it )
+{
+	it->i = it->dom->node[it->last].end;
+}
+
 /* EOF */
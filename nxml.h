@@ -18,6 +18,8 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
+
 typedef enum nxmlTagtype {
 	NXML_TYPE_EMPTY = 0,
 	NXML_TYPE_CONTENT,
@@ -49,12 +51,82 @@ typedef struct {
 	nxmlAttrib_t *att;
 	size_t att_num;
 	size_t att_sz;
+	size_t offset;		// input byte offset of markup or text
 	int error;
 } nxmlNode_t;
 
+/*
+ * Callbacks return 0 to continue, NXML_SKIP from the OPEN event of a
+ * parent element to skip its content up to the matching end tag (the
+ * CLOSE event is still delivered), or any other value to abort.
+ */
+#define NXML_SKIP	2
+
 typedef int (*nxmlCb_t)( nxmlEvent_t evt, const nxmlNode_t *node, void *usr );
 
+// event mask: content not to report
+#define NXML_IGN_TEXT		0x01	// text is neither trimmed nor reported
+#define NXML_IGN_COMMENT	0x02
+#define NXML_IGN_CDATA		0x04
+#define NXML_IGN_PROC		0x08	// processing instructions and doctype
+
+/*
+ * Parser options; ignore is re-read for every node, so the callback
+ * may update it while parsing.
+ */
+typedef struct {
+	arena_t *arena;		// allocate from arena instead of heap, if set
+	unsigned ignore;	// NXML_IGN_* flags
+} nxmlOpt_t;
+
 int nxmlParse( char *buf, nxmlCb_t cb, void *usr );
+int nxmlParseOpt( char *buf, nxmlCb_t cb, void *usr, const nxmlOpt_t *opt );
+int nxmlHasElement( const char *buf, const char *name );
+
+/*
+ * Compact DOM, built in an arena: nodes are stored in document order
+ * (pre-order) in one array, with node 0 representing the document
+ * itself; index 0 thus also serves as "none" for child and sibling
+ * links. Attribute and text strings point into the parsed buffer,
+ * element and attribute names are interned, so names obtained from
+ * nxmlDomName() can be compared by pointer.
+ */
+typedef struct {
+	const char *name;		// element name or text content
+	nxmlTagtype_t type;		// PARENT, SELF, CONTENT, CDATA, ...
+	unsigned parent;		// parent node, 0 for top level nodes
+	unsigned child;			// first child
+	unsigned next;			// next sibling
+	unsigned end;			// index past last descendant
+	unsigned att;			// first attribute in nxmlDom_t.att
+	unsigned att_num;		// number of attributes
+	size_t offset;			// input byte offset
+} nxmlDomNode_t;
+
+typedef struct {
+	nxmlDomNode_t *node;
+	size_t nnode;
+	nxmlAttrib_t *att;
+	size_t natt;
+	const char **names;		// intern table, open addressing
+	size_t names_sz;
+	size_t names_num;
+} nxmlDom_t;
+
+typedef struct {
+	const nxmlDom_t *dom;
+	unsigned i;				// next node
+	unsigned end;			// end of iterated subtree
+	unsigned last;			// node last returned
+} nxmlDomIter_t;
+
+nxmlDom_t *nxmlDomBuild( char *buf, const nxmlOpt_t *opt );
+const char *nxmlDomName( const nxmlDom_t *dom, const char *name );
+const char *nxmlDomAttr( const nxmlDom_t *dom, unsigned n, const char *iname );
+int nxmlDomWalk( const nxmlDom_t *dom, unsigned root, nxmlCb_t cb, void *usr );
+void nxmlDomIterInit( nxmlDomIter_t *it, const nxmlDom_t *dom, unsigned root );
+const nxmlDomNode_t *nxmlDomIterNext( nxmlDomIter_t *it );
+void nxmlDomIterSkip( nxmlDomIter_t *it );
 
 #ifdef __cplusplus
 	}
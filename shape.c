@@ -0,0 +1,139 @@
+/*
+ * Shape geometry in user space, as produced by the element converters.
+ *
+ * Project: svg2ass
+ *    File: shape.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "shape.h"
+
+
+#define SHP_SZ_MIN	64
+
+int shpGrow( shape_t *s )
+{
+	size_t sz = s->sz ? 2 * s->sz : SHP_SZ_MIN;
+	void *p;
+
+	if ( s->arena )
+		p = arenaGrow( s->arena, s->pt, s->sz * sizeof *s->pt, sz * sizeof *s->pt );
+	else
+		p = realloc( s->pt, sz * sizeof *s->pt );
+	if ( !p )
+		return -1;
+	s->pt = p;
+	s->sz = sz;
+	return 0;
+}
+
+/*
+ * Copy shape s to d, allocating from arena a.
+ */
+int shpCopy( shape_t *d, const shape_t *s, arena_t *a )
+{
+	d->arena = a;
+	d->num = d->sz = s->num;
+	if ( NULL == ( d->pt = arenaAlloc( a, s->num * sizeof *s->pt ) ) )
+		return -1;
+	memcpy( d->pt, s->pt, s->num * sizeof *s->pt );
+	return 0;
+}
+
+/*
+ * Append the points of line run p[a+1..b] to d that are farther than
+ * tol from the chord of their enclosing subrun (Ramer-Douglas-Peucker),
+ * p[b] always. Subruns are kept on an explicit stack, runs can be long.
+ */
+static int simplifyRun( shape_t *d, const shpPoint_t *p, size_t a, size_t b, double tol )
+{
+	static size_t *stk = NULL;
+	static size_t stksz = 0;
+	size_t sp = 0, i, m, first = d->num;
+	double dm, dd, len;
+	vec_t u, w;
+
+	if ( stksz < 2 * ( b - a ) + 2 )
+	{
+		size_t sz = 2 * ( b - a ) + 2;
+		void *q = realloc( stk, sz * sizeof *stk );
+		if ( !q )
+			return -1;
+		stk = q;
+		stksz = sz;
+	}
+	stk[sp++] = b;
+	while ( sp )
+	{	// a is the last point written, stk[sp-1] the end of the subrun
+		b = stk[sp - 1];
+		u = vec_sub( p[b].v, p[a].v );
+		len = vec_abs( u );
+		for ( dm = 0.0, m = a, i = a + 1; i < b; ++i )
+		{
+			w = vec_sub( p[i].v, p[a].v );
+			dd = len > 0.0 ? fabs( u.x * w.y - u.y * w.x ) / len : vec_abs( w );
+			if ( dd > dm )
+			{
+				dm = dd;
+				m = i;
+			}
+		}
+		if ( dm > tol )
+			stk[sp++] = m;
+		else
+		{
+			if ( 0 != shpAdd( d, d->num == first ? 'l' : 0, p[b].v ) )
+				return -1;
+			a = b;
+			--sp;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Copy shape s to d, dropping line points that deviate by no more than
+ * tol from the simplified outline. Curves are copied unchanged.
+ */
+int shpSimplify( shape_t *d, const shape_t *s, double tol )
+{
+	size_t i = 0, j;
+	int cur = 0;
+
+	d->num = 0;
+	while ( i < s->num )
+	{
+		if ( i && ( 'l' == s->pt[i].cmd || ( !s->pt[i].cmd && 'l' == cur ) ) )
+		{	// line run from the previous point to the last line point
+			for ( j = i + 1; j < s->num && ( !s->pt[j].cmd || 'l' == s->pt[j].cmd ); ++j )
+				;
+			if ( 0 != simplifyRun( d, s->pt, i - 1, j - 1, tol ) )
+				return -1;
+			i = j;
+			cur = 'l';
+			continue;
+		}
+		if ( s->pt[i].cmd )
+			cur = s->pt[i].cmd;
+		if ( 0 != shpAdd( d, s->pt[i].cmd, s->pt[i].v ) )
+			return -1;
+		++i;
+	}
+	return 0;
+}
+
+void shpFree( shape_t *s )
+{
+	if ( !s->arena )
+		free( s->pt );
+	s->pt = NULL;
+	s->num = s->sz = 0;
+}
+
+/* EOF */
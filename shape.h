@@ -0,0 +1,62 @@
+/*
+ * Shape geometry in user space, as produced by the element converters.
+ *
+ * Project: svg2ass
+ *    File: shape.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_SHAPE_INCLUDED
+#define H_SHAPE_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <stdlib.h>
+
+#include "arena.h"
+#include "vect.h"
+
+/*
+ * A shape is a sequence of points, each optionally preceded by an ASS
+ * drawing command ('m', 'l', 'b'); points without command continue
+ * the previous one. Coordinates are untransformed; the CTM is only
+ * applied on output, so a shape can be reused under different CTMs.
+ */
+typedef struct {
+	int cmd;		// drawing command, or 0
+	vec_t v;
+} shpPoint_t;
+
+typedef struct {
+	shpPoint_t *pt;
+	size_t num;
+	size_t sz;
+	arena_t *arena;		// storage, or NULL for heap
+} shape_t;
+
+int shpGrow( shape_t *s );
+int shpCopy( shape_t *d, const shape_t *s, arena_t *a );
+int shpSimplify( shape_t *d, const shape_t *s, double tol );
+void shpFree( shape_t *s );
+
+static inline int shpAdd( shape_t *s, int cmd, vec_t v )
+{
+	if ( s->num >= s->sz && 0 != shpGrow( s ) )
+		return -1;
+	s->pt[s->num].cmd = cmd;
+	s->pt[s->num++].v = v;
+	return 0;
+}
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_SHAPE_INCLUDED
+
+/* EOF */
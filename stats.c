@@ -0,0 +1,171 @@
+/*
+ * Conversion phase timing and statistics.
+ *
+ * Project: svg2ass
+ *    File: stats.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "stats.h"
+
+
+stats_t stats;
+
+static const char *phase_name[STATS_PH_NUM] = {
+	"idle", "read", "tokenize", "style", "geometry", "format",
+};
+
+// element names counted individually, anything else is "other"
+static const char *elem_name[STATS_ELEM_NUM] = {
+	"svg", "g", "line", "rect", "circle", "ellipse",
+	"path", "polyline", "polygon", "use", "other",
+};
+
+double statsNow( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void statsReset( void )
+{
+	int enabled = stats.enabled;
+
+	memset( &stats, 0, sizeof stats );
+	stats.enabled = enabled;
+	stats.cur = STATS_PH_IDLE;
+	stats.last = enabled ? statsNow() : 0.0;
+}
+
+/*
+ * Charge the time elapsed since the last switch to the current phase,
+ * make ph the current phase and return the previous one.
+ */
+statsPhase_t statsPhase( statsPhase_t ph )
+{
+	statsPhase_t prev = stats.cur;
+	double t = statsNow();
+
+	stats.t[prev] += t - stats.last;
+	stats.last = t;
+	stats.cur = ph;
+	return prev;
+}
+
+void statsElement( const char *name )
+{
+	int i;
+
+	if ( !stats.enabled )
+		return;
+	for ( i = 0; i < STATS_ELEM_NUM - 1; ++i )
+		if ( 0 == strcasecmp( elem_name[i], name ) )
+			break;
+	++stats.elem[i];
+}
+
+void statsPrint( FILE *fp, statsFormat_t fmt, const char *docname )
+{
+	int i;
+	const char *sep;
+	double total = 0.0;
+
+	if ( STATS_FMT_NONE == fmt )
+		return;
+	statsPhase( STATS_PH_IDLE );
+	for ( i = STATS_PH_READ; i < STATS_PH_NUM; ++i )
+		total += stats.t[i];
+
+	if ( STATS_FMT_JSON == fmt )
+	{
+		fprintf( fp, "{\"document\":\"" );
+		for ( ; *docname; ++docname )
+		{
+			if ( '"' == *docname || '\\' == *docname )
+				fputc( '\\', fp );
+			fputc( *docname, fp );
+		}
+		fprintf( fp, "\",\"time_s\":{" );
+		for ( i = STATS_PH_READ; i < STATS_PH_NUM; ++i )
+			fprintf( fp, "\"%s\":%.6f,", phase_name[i], stats.t[i] );
+		fprintf( fp, "\"total\":%.6f},\"elements\":{", total );
+		for ( i = 0; i < STATS_ELEM_NUM; ++i )
+			fprintf( fp, "%s\"%s\":%lu", i ? "," : "", elem_name[i], stats.elem[i] );
+		fprintf( fp, "},\"path_commands\":{" );
+		for ( sep = "", i = 0; i < 26; ++i )
+		{
+			if ( stats.pcmd[i] )
+			{
+				fprintf( fp, "%s\"%c\":%lu", sep, 'A' + i, stats.pcmd[i] );
+				sep = ",";
+			}
+		}
+		fprintf( fp, "},\"arc_segments\":%lu,\"points\":%lu,\"dialogue_lines\":%lu,"
+				"\"transform_cache\":{\"hits\":%lu,\"misses\":%lu},"
+				"\"use_cache\":{\"hits\":%lu,\"misses\":%lu},"
+				"\"memo\":{\"hits\":%lu,\"misses\":%lu,\"flushes\":%lu,\"bytes\":%zu},"
+				"\"limits\":{\"points\":%lu,\"depth\":%lu,\"attrs\":%lu,\"uses\":%lu,\"bytes\":%lu,\"time\":%lu},"
+				"\"input_bytes\":%llu,\"input_gz_bytes\":%llu,\"input_mb_s\":%.3f,"
+				"\"output_bytes\":%llu,\"max_depth\":%zu,"
+				"\"arena\":{\"high\":%zu,\"capacity\":%zu}}\n",
+				stats.arc_segs, stats.points, stats.lines, stats.trf_hits, stats.trf_misses,
+				stats.use_hits, stats.use_misses,
+				stats.memo_hits, stats.memo_misses, stats.memo_flushes, stats.memo_bytes,
+				stats.lim_points, stats.lim_depth, stats.lim_attrs, stats.lim_uses, stats.lim_bytes,
+				stats.lim_time,
+				stats.in_bytes, stats.in_gz_bytes, total > 0.0 ? stats.in_bytes / total / 1e6 : 0.0,
+				stats.out_bytes, stats.max_depth, stats.arena_high, stats.arena_cap );
+	}
+	else
+	{
+		fprintf( fp, "Statistics for %s:\n", docname );
+		fprintf( fp, "  %-18s %12s %8s\n", "phase", "time [ms]", "share" );
+		for ( i = STATS_PH_READ; i < STATS_PH_NUM; ++i )
+			fprintf( fp, "  %-18s %12.3f %7.1f%%\n", phase_name[i], stats.t[i] * 1e3,
+					total > 0.0 ? stats.t[i] * 100.0 / total : 0.0 );
+		fprintf( fp, "  %-18s %12.3f\n", "total", total * 1e3 );
+		fprintf( fp, "  elements:" );
+		for ( i = 0; i < STATS_ELEM_NUM; ++i )
+			if ( stats.elem[i] )
+				fprintf( fp, " %s=%lu", elem_name[i], stats.elem[i] );
+		fprintf( fp, "\n  path commands:" );
+		for ( i = 0; i < 26; ++i )
+			if ( stats.pcmd[i] )
+				fprintf( fp, " %c=%lu", 'A' + i, stats.pcmd[i] );
+		fprintf( fp, "\n" );
+		fprintf( fp, "  %-18s %12lu\n", "arc segments", stats.arc_segs );
+		fprintf( fp, "  %-18s %12lu\n", "points", stats.points );
+		fprintf( fp, "  %-18s %12lu\n", "dialogue lines", stats.lines );
+		fprintf( fp, "  %-18s %12lu / %lu\n", "transform cache", stats.trf_hits,
+				stats.trf_hits + stats.trf_misses );
+		fprintf( fp, "  %-18s %12lu / %lu\n", "use cache", stats.use_hits,
+				stats.use_hits + stats.use_misses );
+		fprintf( fp, "  %-18s %12lu / %lu\n", "fragment memo", stats.memo_hits,
+				stats.memo_hits + stats.memo_misses );
+		fprintf( fp, "  %-18s %12zu / %lu\n", "memo bytes/flushes", stats.memo_bytes,
+				stats.memo_flushes );
+		fprintf( fp, "  limits hit: points=%lu depth=%lu attrs=%lu uses=%lu bytes=%lu time=%lu\n",
+				stats.lim_points, stats.lim_depth, stats.lim_attrs, stats.lim_uses,
+				stats.lim_bytes, stats.lim_time );
+		fprintf( fp, "  %-18s %12llu\n", "input bytes", stats.in_bytes );
+		if ( stats.in_gz_bytes )
+			fprintf( fp, "  %-18s %12llu (%.1f:1)\n", "compressed bytes", stats.in_gz_bytes,
+					(double)stats.in_bytes / stats.in_gz_bytes );
+		fprintf( fp, "  %-18s %12.3f\n", "input MB/s", total > 0.0 ? stats.in_bytes / total / 1e6 : 0.0 );
+		fprintf( fp, "  %-18s %12llu\n", "output bytes", stats.out_bytes );
+		fprintf( fp, "  %-18s %12zu\n", "max stack depth", stats.max_depth );
+		fprintf( fp, "  %-18s %12zu / %zu\n", "arena high/cap", stats.arena_high,
+				stats.arena_cap );
+	}
+}
+
+/* EOF */
@@ -0,0 +1,105 @@
+/*
+ * Conversion phase timing and statistics.
+ *
+ * Project: svg2ass
+ *    File: stats.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_STATS_INCLUDED
+#define H_STATS_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <stdio.h>
+
+typedef enum {
+	STATS_PH_IDLE = 0,	// not attributed to any phase
+	STATS_PH_READ,		// reading input (getFile)
+	STATS_PH_TOKENIZE,	// XML tokenizer, excluding callbacks
+	STATS_PH_STYLE,		// style and transform parsing
+	STATS_PH_GEOMETRY,	// shape and path geometry generation
+	STATS_PH_FORMAT,	// number formatting and output writing
+	STATS_PH_NUM
+} statsPhase_t;
+
+typedef enum {
+	STATS_FMT_NONE = 0,
+	STATS_FMT_TEXT,
+	STATS_FMT_JSON,
+} statsFormat_t;
+
+#define STATS_ELEM_NUM	11
+
+typedef struct {
+	int enabled;
+	statsPhase_t cur;				// phase currently running
+	double last;					// timestamp of last phase switch
+	double t[STATS_PH_NUM];			// exclusive time per phase [s]
+	unsigned long elem[STATS_ELEM_NUM];	// elements by type, see stats.c
+	unsigned long pcmd[26];			// path commands by letter, case folded
+	unsigned long arc_segs;			// line segments generated for arcs
+	unsigned long points;			// coordinate pairs written
+	unsigned long lines;			// ASS dialogue lines
+	unsigned long trf_hits;			// transform cache hits
+	unsigned long trf_misses;		// transform cache misses
+	unsigned long use_hits;			// <use> geometry cache hits
+	unsigned long use_misses;		// <use> geometry cache misses
+	unsigned long memo_hits;		// drawing fragment memo hits
+	unsigned long memo_misses;		// drawing fragment memo misses
+	unsigned long memo_flushes;		// memo flushed for exceeding its limit
+	unsigned long lim_points;		// shapes truncated by points limit
+	unsigned long lim_depth;		// elements skipped by depth limit
+	unsigned long lim_attrs;		// elements skipped by attribute limit
+	unsigned long lim_uses;			// <use> elements skipped by use limit
+	unsigned long lim_bytes;		// conversions aborted by output limit
+	unsigned long lim_time;			// conversions aborted by time limit
+	unsigned long long in_bytes;	// input document size
+	unsigned long long in_gz_bytes;	// compressed input size, 0 for plain input
+	unsigned long long out_bytes;	// generated output
+	size_t max_depth;				// context stack high-water mark
+	size_t arena_high;				// arena high-water mark [bytes]
+	size_t arena_cap;				// arena capacity [bytes]
+	size_t memo_bytes;				// drawing fragment memo size [bytes]
+} stats_t;
+
+extern stats_t stats;
+
+double statsNow( void );
+void statsReset( void );
+statsPhase_t statsPhase( statsPhase_t ph );
+void statsElement( const char *name );
+void statsPrint( FILE *fp, statsFormat_t fmt, const char *docname );
+
+/*
+ * Phase accounting: STATS_ENTER switches to a new phase, charging the
+ * elapsed time to the phase left, STATS_LEAVE returns to the previous
+ * one. When statistics are disabled at run time this costs no more
+ * than a flag test; building with -DNSTATS removes it altogether.
+ */
+#ifndef NSTATS
+#define STATS_ENTER(P)	statsPhase_t stats_prev_ = stats.enabled ? statsPhase( P ) : STATS_PH_IDLE
+#define STATS_LEAVE()	do { if ( stats.enabled ) statsPhase( stats_prev_ ); } while (0)
+#define STATS_INC(F)	do { ++stats.F; } while (0)
+#define STATS_ADD(F,N)	do { stats.F += (N); } while (0)
+#define STATS_MAX(F,N)	do { if ( (N) > stats.F ) stats.F = (N); } while (0)
+#else
+#define STATS_ENTER(P)
+#define STATS_LEAVE()
+#define STATS_INC(F)
+#define STATS_ADD(F,N)
+#define STATS_MAX(F,N)
+#endif
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_STATS_INCLUDED
+
+/* EOF */
@@ -0,0 +1,322 @@
+/*
+ * Stroke to outline conversion.
+ *
+ * Project: svg2ass
+ *    File: stroke.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * The input shape is transformed to output space and flattened, then
+ * each subpath is offset by half the stroke width to either side.
+ * Open subpaths become a single polygon: left side forward, end cap,
+ * left side of the reversed subpath, start cap. Closed subpaths become
+ * two rings of opposite orientation. Inner joins are routed through
+ * the vertex, so the outline overlaps itself there; it is meant to be
+ * filled using the nonzero winding rule, as libass does.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "stroke.h"
+
+#ifndef M_PI
+	#define M_PI	3.14159265358979323846
+#endif
+
+#define EPS		1e-9
+
+static shape_t flat;	// flattened subpath, reused
+
+static inline vec_t perp( vec_t v )
+{
+	return VEC( -v.y, v.x );
+}
+
+static inline vec_t rot( vec_t v, double a )
+{
+	double c = cos( a ), s = sin( a );
+	return VEC( c * v.x - s * v.y, s * v.x + c * v.y );
+}
+
+static inline vec_t dir( vec_t u, vec_t v )
+{
+	vec_t d = vec_sub( v, u );
+	return vec_scal( d, 1.0 / vec_abs( d ) );
+}
+
+static inline int put( shape_t *out, int *first, vec_t v )
+{
+	int cmd;
+
+	if ( !*first && vec_eq( out->pt[out->num - 1].v, v, EPS ) )
+		return 0;
+	cmd = *first ? 'm' : ( 'm' == out->pt[out->num - 1].cmd ? 'l' : 0 );
+	*first = 0;
+	return shpAdd( out, cmd, v );
+}
+
+/*
+ * Steps for a circular arc of angle a, keeping the chord error below
+ * the tolerance.
+ */
+static inline int arcSteps( const strokeStyle_t *st, double a )
+{
+	double r = st->width / 2;
+	double da = r > st->tol ? 2 * acos( 1 - st->tol / r ) : M_PI / 2;
+	int n = (int)ceil( fabs( a ) / da );
+	return n < 1 ? 1 : n > 256 ? 256 : n;
+}
+
+/*
+ * Arc around c, starting at c+n, turning by angle a; the start point
+ * itself is not added.
+ */
+static int arc( shape_t *out, int *first, const strokeStyle_t *st, vec_t c, vec_t n, double a )
+{
+	int i, k = arcSteps( st, a ), r = 0;
+
+	for ( i = 1; i <= k; ++i )
+		r |= put( out, first, vec_add( c, rot( n, a * i / k ) ) );
+	return r;
+}
+
+/*
+ * Left side join at vertex p, between incoming direction a and
+ * outgoing direction b; l is the length of the shorter segment.
+ */
+static int join( shape_t *out, int *first, const strokeStyle_t *st, vec_t p, vec_t a, vec_t b, double l )
+{
+	double hw = st->width / 2;
+	vec_t n0 = vec_scal( perp( a ), hw ), n1 = vec_scal( perp( b ), hw );
+	double cr = a.x * b.y - a.y * b.x, dt = vec_dot( a, b ), phi;
+	int r = 0;
+
+	if ( fabs( cr ) < EPS && dt > 0 )	// straight on
+		return put( out, first, vec_add( p, n0 ) );
+	if ( cr > EPS )
+	{	// inner side: offset lines intersect within both segments?
+		if ( 1 + dt > EPS && hw * cr <= l * ( 1 + dt ) )
+			return put( out, first, vec_add( p, vec_scal( vec_add( n0, n1 ), 1 / ( 1 + dt ) ) ) );
+		r |= put( out, first, vec_add( p, n0 ) );
+		r |= put( out, first, p );
+		return r | put( out, first, vec_add( p, n1 ) );
+	}
+	// miter length / stroke width = 1 / sin( angle / 2 )
+	if ( STROKE_JOIN_MITER == st->join && 1 + dt > EPS
+		&& 2 / ( 1 + dt ) <= st->miterlimit * st->miterlimit )
+		return put( out, first, vec_add( p, vec_scal( vec_add( n0, n1 ), 1 / ( 1 + dt ) ) ) );
+	r |= put( out, first, vec_add( p, n0 ) );
+	if ( STROKE_JOIN_ROUND == st->join )
+	{
+		phi = -fabs( atan2( cr, dt ) );
+		r |= arc( out, first, st, p, n0, phi );
+	}
+	return r | put( out, first, vec_add( p, n1 ) );
+}
+
+/*
+ * Cap at end point p of direction d, from the left to the right side;
+ * the left side point is already in place.
+ */
+static int cap( shape_t *out, int *first, const strokeStyle_t *st, vec_t p, vec_t d )
+{
+	double hw = st->width / 2;
+	vec_t n = vec_scal( perp( d ), hw ), e = vec_scal( d, hw );
+	int r = 0;
+
+	switch ( st->cap )
+	{
+	case STROKE_CAP_ROUND:
+		return arc( out, first, st, p, n, -M_PI );
+	case STROKE_CAP_SQUARE:
+		r |= put( out, first, vec_add( vec_add( p, n ), e ) );
+		r |= put( out, first, vec_sub( vec_add( p, e ), n ) );
+		/* fall through */
+	default:
+		return r | put( out, first, vec_sub( p, n ) );
+	}
+}
+
+/*
+ * Left side of the flattened subpath, forward (step 1) or reversed
+ * (step -1), up to the last point, excluding its join or cap.
+ */
+static int side( shape_t *out, int *first, const strokeStyle_t *st, int step, int closed )
+{
+	const shpPoint_t *pt = flat.pt;
+	long n = flat.num, i, j, k, l;
+	vec_t a, b;
+	int r = 0;
+
+	i = step > 0 ? 0 : n - 1;
+	if ( closed )
+	{	// joins at all vertices, starting with the first
+		for ( k = 0; k < n; ++k, i = ( i + step + n ) % n )
+		{
+			j = ( i - step + n ) % n;
+			l = ( i + step + n ) % n;
+			a = dir( pt[j].v, pt[i].v );
+			b = dir( pt[i].v, pt[l].v );
+			r |= join( out, first, st, pt[i].v, a, b,
+					fmin( vec_abs( vec_sub( pt[i].v, pt[j].v ) ), vec_abs( vec_sub( pt[l].v, pt[i].v ) ) ) );
+		}
+		return r;
+	}
+	b = dir( pt[i].v, pt[i + step].v );
+	r |= put( out, first, vec_add( pt[i].v, vec_scal( perp( b ), st->width / 2 ) ) );
+	for ( k = 1, i += step; k < n - 1; ++k, i += step )
+	{
+		a = b;
+		b = dir( pt[i].v, pt[i + step].v );
+		r |= join( out, first, st, pt[i].v, a, b,
+				fmin( vec_abs( vec_sub( pt[i].v, pt[i - step].v ) ), vec_abs( vec_sub( pt[i + step].v, pt[i].v ) ) ) );
+	}
+	return r | put( out, first, vec_add( pt[i].v, vec_scal( perp( b ), st->width / 2 ) ) );
+}
+
+/*
+ * Stroke the flattened subpath.
+ */
+static int subpath( shape_t *out, const strokeStyle_t *st, int closed )
+{
+	const shpPoint_t *pt = flat.pt;
+	double hw = st->width / 2;
+	vec_t p, d;
+	int first, r = 0;
+
+	if ( closed && flat.num > 1 && vec_eq( pt[0].v, pt[flat.num - 1].v, EPS ) )
+		--flat.num;
+	if ( 1 == flat.num || ( 2 == flat.num && closed ) )
+		closed = 0;
+	if ( 0 == flat.num )
+		return 0;
+	if ( 1 == flat.num )
+	{	// zero length: round and square caps still render
+		p = pt[0].v;
+		first = 1;
+		if ( STROKE_CAP_ROUND == st->cap )
+		{
+			r |= put( out, &first, vec_add( p, VEC( hw, 0 ) ) );
+			r |= arc( out, &first, st, p, VEC( hw, 0 ), 2 * M_PI );
+		}
+		else if ( STROKE_CAP_SQUARE == st->cap )
+		{
+			r |= put( out, &first, vec_add( p, VEC( -hw, -hw ) ) );
+			r |= put( out, &first, vec_add( p, VEC( hw, -hw ) ) );
+			r |= put( out, &first, vec_add( p, VEC( hw, hw ) ) );
+			r |= put( out, &first, vec_add( p, VEC( -hw, hw ) ) );
+		}
+		return r;
+	}
+	first = 1;
+	r |= side( out, &first, st, 1, closed );
+	if ( closed )
+		first = 1;
+	else
+	{
+		p = pt[flat.num - 1].v;
+		d = dir( pt[flat.num - 2].v, p );
+		r |= cap( out, &first, st, p, d );
+	}
+	r |= side( out, &first, st, -1, closed );
+	if ( !closed )
+		r |= cap( out, &first, st, pt[0].v, dir( pt[1].v, pt[0].v ) );
+	return r;
+}
+
+static inline int addFlat( vec_t v )
+{
+	if ( flat.num && vec_eq( flat.pt[flat.num - 1].v, v, EPS ) )
+		return 0;
+	return shpAdd( &flat, 0, v );
+}
+
+/*
+ * Flatten cubic Bezier curve from p0, the number of segments follows
+ * from the maximum second difference of the control polygon.
+ */
+static int bezier( vec_t p0, vec_t p1, vec_t p2, vec_t p3, double tol )
+{
+	vec_t d1 = vec_add( vec_sub( p0, vec_scal( p1, 2 ) ), p2 );
+	vec_t d2 = vec_add( vec_sub( p1, vec_scal( p2, 2 ) ), p3 );
+	double dd = fmax( vec_abs( d1 ), vec_abs( d2 ) );
+	int i, n = (int)ceil( sqrt( 0.75 * dd / tol ) ), r = 0;
+	double t, u;
+
+	if ( n < 1 )
+		n = 1;
+	else if ( n > 256 )
+		n = 256;
+	for ( i = 1; i <= n; ++i )
+	{
+		t = (double)i / n;
+		u = 1 - t;
+		r |= addFlat( VEC( u*u*u * p0.x + 3*u*u*t * p1.x + 3*u*t*t * p2.x + t*t*t * p3.x,
+						   u*u*u * p0.y + 3*u*u*t * p1.y + 3*u*t*t * p2.y + t*t*t * p3.y ) );
+	}
+	return r;
+}
+
+/*
+ * Convert the stroke of a shape, transformed by m, to outline polygons
+ * appended to out. Subpaths are closed by a 'z' point in the input.
+ */
+int strokeShape( shape_t *out, const shape_t *in, mtx_t m, const strokeStyle_t *st )
+{
+	size_t i;
+	int cmd = 'm', r = 0;
+	vec_t v, start = VEC_ZERO;
+
+	if ( st->width <= 0 )
+		return 0;
+	flat.num = 0;
+	for ( i = 0; i < in->num && 0 == r; ++i )
+	{
+		if ( in->pt[i].cmd )
+			cmd = in->pt[i].cmd;
+		v = vec_mmul( m, in->pt[i].v );
+		switch ( cmd )
+		{
+		case 'z':	// drawing may continue at the subpath start
+			r |= subpath( out, st, 1 );
+			flat.num = 0;
+			cmd = 'l';
+			break;
+		case 'm':
+			r |= subpath( out, st, 0 );
+			flat.num = 0;
+			start = v;
+			r |= addFlat( v );
+			cmd = 'l';
+			break;
+		case 'b':
+			if ( i + 2 >= in->num )	// truncated shape
+				return subpath( out, st, 0 );
+			if ( !flat.num )
+				r |= addFlat( start );
+			r |= bezier( flat.pt[flat.num - 1].v, v, vec_mmul( m, in->pt[i + 1].v ),
+						vec_mmul( m, in->pt[i + 2].v ), st->tol );
+			i += 2;
+			cmd = 'l';	// defensively; 'b' is always repeated
+			break;
+		default:
+			if ( !flat.num )
+				r |= addFlat( start );
+			r |= addFlat( v );
+			break;
+		}
+	}
+	if ( 0 == r )
+		r = subpath( out, st, 0 );
+	return r;
+}
+
+void strokeFree( void )
+{
+	shpFree( &flat );
+}
+
+/* EOF */
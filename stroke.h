@@ -0,0 +1,51 @@
+/*
+ * Stroke to outline conversion.
+ *
+ * Project: svg2ass
+ *    File: stroke.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_STROKE_INCLUDED
+#define H_STROKE_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include "shape.h"
+#include "vect.h"
+
+enum {
+	STROKE_JOIN_MITER = 0,
+	STROKE_JOIN_ROUND,
+	STROKE_JOIN_BEVEL,
+};
+
+enum {
+	STROKE_CAP_BUTT = 0,
+	STROKE_CAP_ROUND,
+	STROKE_CAP_SQUARE,
+};
+
+typedef struct {
+	double width;		// stroke width, in output units
+	int join;			// STROKE_JOIN_*
+	int cap;			// STROKE_CAP_*
+	double miterlimit;	// miter length to width ratio
+	double tol;			// flattening tolerance, in output units
+} strokeStyle_t;
+
+int strokeShape( shape_t *out, const shape_t *in, mtx_t m, const strokeStyle_t *st );
+void strokeFree( void );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_STROKE_INCLUDED
+
+/* EOF */
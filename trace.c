@@ -0,0 +1,182 @@
+/*
+ * Per element trace output in Chrome trace-event format.
+ *
+ * Project: svg2ass
+ *    File: trace.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * Every converted element is written as a complete ("X") event,
+ * carrying element name, id attribute, input byte offset, points
+ * generated and output bytes. Style parsing and geometry generation
+ * are recorded as nested spans. As path parsing and emission are
+ * interleaved per path command, the geometry span reports the time
+ * spent in each of both as arguments instead of separate spans.
+ * Each input document is mapped to its own thread id.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "stats.h"
+
+
+trace_t trace;
+
+typedef struct {
+	const char *name;
+	const char *id;
+	size_t offset;
+	double t0;
+	unsigned long long out0;
+	unsigned long pts0;
+} frame_t;
+
+static struct {
+	frame_t *stk;
+	size_t sz;
+	size_t top;
+	double epoch;
+	frame_t mark;
+	double ph0[STATS_PH_NUM];
+} tr;
+
+static void putstr( const char *s )
+{
+	fputc( '"', trace.fp );
+	for ( ; s && *s; ++s )
+	{
+		if ( '"' == *s || '\\' == *s )
+			fputc( '\\', trace.fp );
+		if ( (unsigned char)*s >= 0x20 )
+			fputc( *s, trace.fp );
+	}
+	fputc( '"', trace.fp );
+}
+
+static void event( const char *cat, const char *name, double t0, double t1 )
+{
+	fputs( trace.nevt++ ? ",\n" : "\n", trace.fp );
+	fprintf( trace.fp, "{\"cat\":\"%s\",\"name\":", cat );
+	putstr( name );
+	fprintf( trace.fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+			trace.doc, ( t0 - tr.epoch ) * 1e6, ( t1 - t0 ) * 1e6 );
+}
+
+int traceOpen( const char *fname )
+{
+	if ( NULL == ( trace.fp = fopen( fname, "w" ) ) )
+		return -1;
+	// phase accounting is needed for the per span time break-down
+	stats.enabled = 1;
+	tr.epoch = statsNow();
+	fputs( "[", trace.fp );
+	return 0;
+}
+
+int traceClose( void )
+{
+	int res = 0;
+
+	if ( !TRACE_ON )
+		return 0;
+	fputs( "\n]\n", trace.fp );
+	if ( 0 != fclose( trace.fp ) )
+		res = -1;
+	trace.fp = NULL;
+	free( tr.stk );
+	memset( &tr, 0, sizeof tr );
+	return res;
+}
+
+void traceDocument( const char *docname )
+{
+	if ( !TRACE_ON )
+		return;
+	++trace.doc;
+	tr.top = 0;
+	fputs( trace.nevt++ ? ",\n" : "\n", trace.fp );
+	fprintf( trace.fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+			"\"args\":{\"name\":", trace.doc );
+	putstr( docname );
+	fputs( "}}", trace.fp );
+}
+
+/*
+ * Open an element span, to be closed by traceEnd().
+ */
+void traceBegin( const char *name, const char *id, size_t offset )
+{
+	frame_t *f;
+
+	if ( !TRACE_ON )
+		return;
+	if ( tr.top >= tr.sz )
+	{
+		if ( NULL == ( f = realloc( tr.stk, ( tr.sz + 100 ) * sizeof *f ) ) )
+			return;
+		tr.stk = f;
+		tr.sz += 100;
+	}
+	f = &tr.stk[tr.top++];
+	f->name = name;
+	f->id = id;
+	f->offset = offset;
+	f->t0 = statsNow();
+	f->out0 = stats.out_bytes;
+	f->pts0 = stats.points;
+}
+
+void traceEnd( void )
+{
+	frame_t *f;
+
+	if ( !TRACE_ON || !tr.top )
+		return;
+	f = &tr.stk[--tr.top];
+	event( "element", f->name, f->t0, statsNow() );
+	fputs( "\"id\":", trace.fp );
+	putstr( f->id );
+	fprintf( trace.fp, ",\"offset\":%zu,\"points\":%lu,\"output_bytes\":%llu}}",
+			f->offset, stats.points - f->pts0, stats.out_bytes - f->out0 );
+}
+
+/*
+ * Start a nested span, to be written by traceSpan().
+ */
+void traceMark( void )
+{
+	if ( !TRACE_ON )
+		return;
+	statsPhase( stats.cur );	// bring phase times up to date
+	tr.mark.t0 = stats.last;
+	tr.mark.out0 = stats.out_bytes;
+	tr.mark.pts0 = stats.points;
+	memcpy( tr.ph0, stats.t, sizeof tr.ph0 );
+}
+
+/*
+ * Write span from last mark; empty spans are omitted, unless keep_empty
+ * is set.
+ */
+void traceSpan( const char *name, int keep_empty )
+{
+	if ( !TRACE_ON )
+		return;
+	statsPhase( stats.cur );
+	if ( !keep_empty && stats.out_bytes == tr.mark.out0 )
+		return;
+	event( "phase", name, tr.mark.t0, stats.last );
+	fprintf( trace.fp, "\"points\":%lu,\"output_bytes\":%llu,"
+			"\"style_us\":%.3f,\"parse_us\":%.3f,\"format_us\":%.3f}}",
+			stats.points - tr.mark.pts0, stats.out_bytes - tr.mark.out0,
+			( stats.t[STATS_PH_STYLE] - tr.ph0[STATS_PH_STYLE] ) * 1e6,
+			( stats.t[STATS_PH_GEOMETRY] - tr.ph0[STATS_PH_GEOMETRY] ) * 1e6,
+			( stats.t[STATS_PH_FORMAT] - tr.ph0[STATS_PH_FORMAT] ) * 1e6 );
+}
+
+/* EOF */
@@ -0,0 +1,45 @@
+/*
+ * Per element trace output in Chrome trace-event format.
+ *
+ * Project: svg2ass
+ *    File: trace.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_TRACE_INCLUDED
+#define H_TRACE_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <stdio.h>
+
+typedef struct {
+	FILE *fp;		// trace file, NULL if tracing is disabled
+	int doc;		// document number, used as thread id
+	int nevt;		// events written so far
+} trace_t;
+
+extern trace_t trace;
+
+int traceOpen( const char *fname );
+int traceClose( void );
+void traceDocument( const char *docname );
+void traceBegin( const char *name, const char *id, size_t offset );
+void traceEnd( void );
+void traceMark( void );
+void traceSpan( const char *name, int keep_empty );
+
+#define TRACE_ON	( NULL != trace.fp )
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_TRACE_INCLUDED
+
+/* EOF */
@@ -75,4 +75,15 @@ mtx_t mtx_mmul( mtx_t m, mtx_t n )
 	return r;
 }
 
+mtx_kind_t mtx_kind( mtx_t m )
+{
+	if ( 0.0 != m.b || 0.0 != m.c )
+		return MTX_KIND_GENERAL;
+	if ( 1.0 != m.a || 1.0 != m.d )
+		return MTX_KIND_SCALE;
+	if ( 0.0 != m.e || 0.0 != m.f )
+		return MTX_KIND_TRANSLATE;
+	return MTX_KIND_IDENTITY;
+}
+
 /* EOF */
@@ -30,6 +30,15 @@ typedef struct {
 } mtx_t;
 
 
+// matrix kinds, in ascending order of cost to apply
+typedef enum {
+	MTX_KIND_IDENTITY = 0,
+	MTX_KIND_TRANSLATE,		// e, f only
+	MTX_KIND_SCALE,			// a, d, e, f (scale and translate)
+	MTX_KIND_GENERAL,
+} mtx_kind_t;
+
+
 #define VEC(X,Y)			((vec_t){(X),(Y)})
 #define MTX(A,C,E,B,D,F)	((mtx_t){(A),(C),(E),(B),(D),(F)})
 
@@ -52,6 +61,7 @@ double vec_ang( vec_t u, vec_t v );
 int vec_eq( vec_t u, vec_t v, double e );
 
 mtx_t mtx_mmul( mtx_t m, mtx_t n );
+mtx_kind_t mtx_kind( mtx_t m );
 
 
 #ifdef __cplusplus
@@ -0,0 +1,570 @@
+/*
+ * Geometric fidelity check of converted shapes.
+ *
+ * Project: svg2ass
+ *    File: verify.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * Both shapes, given in output pixels with ASS drawing commands, are
+ * flattened and rendered with an anti-aliased scanline rasteriser using
+ * the nonzero winding rule, as libass does: coverage is exact along the
+ * scanline and sampled at VERIFY_SS sub-scanlines per pixel row. The
+ * Hausdorff distance is measured between the flattened outlines, with
+ * the segments of one outline bucketed in a uniform grid.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "verify.h"
+
+
+#define VERIFY_SS		16			// sub-scanlines per pixel row
+#define VERIFY_MAX_PIX	( 1 << 22 )	// raster size limit
+#define VERIFY_MIN_DIM	64			// raster pixels along the longer side, at least
+#define VERIFY_MAX_RES	16.0		// raster pixels per px, at most
+#define VERIFY_FLAT_TOL	0.01		// curve flattening tolerance [px]
+#define VERIFY_STEP		0.1			// outline sampling distance, at least [px]
+#define VERIFY_REL		0.01		// relative outline sampling distance
+#define VERIFY_SAMPLES	200000		// outline samples per direction, about
+#define VERIFY_GRID		128			// grid cells along the longer side, at least
+#define VERIFY_GRID_MAX	1024		// and at most
+
+typedef struct {
+	double y0, y1;	// y0 < y1
+	double x0;		// x at y0
+	double dxdy;
+	int dir;		// winding direction
+} edge_t;
+
+typedef struct {
+	double x;
+	size_t e;
+} cross_t;
+
+typedef struct {
+	struct {
+		vec_t a, b;
+	} *s;
+	size_t num, sz;
+} seg_t;
+
+static shape_t flat[2];		// flattened shapes: 'm' starts a contour
+static seg_t seg[2];		// their segments
+
+static struct {
+	edge_t *e;
+	size_t num, sz;
+	cross_t *x;			// active edges, by crossing
+	size_t xsz;
+	float *cov[2];		// coverage
+	size_t csz;
+} ras;
+
+static struct {
+	size_t *start;		// per cell, index into idx
+	size_t *idx;		// segment indices
+	size_t sz, isz;
+	double ox, oy, cs;
+	long nx, ny;
+} grid;
+
+#define GROW( p, sz, n )	( (sz) >= (n) ? 0 : growArray( (void **)&(p), &(sz), (n), sizeof *(p) ) )
+
+static int growArray( void **p, size_t *sz, size_t n, size_t esz )
+{
+	void *q = realloc( *p, n * esz );
+	if ( !q )
+		return -1;
+	*p = q;
+	*sz = n;
+	return 0;
+}
+
+
+/************************************************************
+ *	Flattening
+ */
+
+static int bezier( shape_t *d, vec_t p0, vec_t p1, vec_t p2, vec_t p3 )
+{
+	vec_t d1 = vec_add( vec_sub( p0, vec_scal( p1, 2 ) ), p2 );
+	vec_t d2 = vec_add( vec_sub( p1, vec_scal( p2, 2 ) ), p3 );
+	double dd = fmax( vec_abs( d1 ), vec_abs( d2 ) );
+	int i, n = (int)ceil( sqrt( 0.75 * dd / VERIFY_FLAT_TOL ) ), r = 0;
+	double t, u;
+
+	n = n < 1 ? 1 : n > 1024 ? 1024 : n;
+	for ( i = 1; i <= n; ++i )
+	{
+		t = (double)i / n;
+		u = 1 - t;
+		r |= shpAdd( d, 0, VEC( u*u*u * p0.x + 3*u*u*t * p1.x + 3*u*t*t * p2.x + t*t*t * p3.x,
+								u*u*u * p0.y + 3*u*u*t * p1.y + 3*u*t*t * p2.y + t*t*t * p3.y ) );
+	}
+	return r;
+}
+
+/*
+ * Flatten shape s into contours; 'z' markers are ignored, as ASS
+ * closes all contours anyway.
+ */
+static int flatten( shape_t *d, const shape_t *s )
+{
+	size_t i;
+	int cmd = 0, r = 0;
+
+	d->num = 0;
+	for ( i = 0; i < s->num && 0 == r; ++i )
+	{
+		if ( s->pt[i].cmd )
+			cmd = s->pt[i].cmd;
+		if ( 'z' == s->pt[i].cmd )
+			continue;
+		if ( 'm' == s->pt[i].cmd || 0 == d->num )
+			r = shpAdd( d, 'm', s->pt[i].v );
+		else if ( 'b' == cmd )
+		{
+			if ( i + 2 >= s->num )
+				break;
+			r = bezier( d, d->pt[d->num - 1].v, s->pt[i].v, s->pt[i + 1].v, s->pt[i + 2].v );
+			i += 2;
+		}
+		else
+			r = shpAdd( d, 0, s->pt[i].v );
+	}
+	return r;
+}
+
+/*
+ * Collect the segments of the closed contours of d.
+ */
+static int segments( seg_t *sg, const shape_t *d )
+{
+	size_t i, s = 0;
+
+	sg->num = 0;
+	if ( 0 != GROW( sg->s, sg->sz, d->num ? d->num : 1 ) )
+		return -1;
+	for ( i = 0; i < d->num; ++i )
+	{
+		if ( 'm' == d->pt[i].cmd )
+			s = i;
+		sg->s[sg->num].a = d->pt[i].v;
+		sg->s[sg->num++].b = i + 1 < d->num && 'm' != d->pt[i + 1].cmd ? d->pt[i + 1].v : d->pt[s].v;
+	}
+	return 0;
+}
+
+
+/************************************************************
+ *	Rasteriser
+ */
+
+static int edgeCmp( const void *a, const void *b )
+{
+	double d = ( (const edge_t *)a )->y0 - ( (const edge_t *)b )->y0;
+	return ( d > 0 ) - ( d < 0 );
+}
+
+static int buildEdges( const seg_t *sg, vec_t o, double res )
+{
+	edge_t *e;
+	vec_t a, b;
+	size_t i;
+
+	ras.num = 0;
+	if ( 0 != GROW( ras.e, ras.sz, sg->num ) )
+		return -1;
+	for ( i = 0; i < sg->num; ++i )
+	{
+		a = vec_scal( vec_sub( sg->s[i].a, o ), res );
+		b = vec_scal( vec_sub( sg->s[i].b, o ), res );
+		if ( a.y == b.y )
+			continue;
+		e = &ras.e[ras.num++];
+		e->dir = a.y < b.y ? 1 : -1;
+		if ( a.y > b.y )
+		{
+			vec_t t = a;
+			a = b;
+			b = t;
+		}
+		e->y0 = a.y;
+		e->y1 = b.y;
+		e->x0 = a.x;
+		e->dxdy = ( b.x - a.x ) / ( b.y - a.y );
+	}
+	return 0;
+}
+
+static inline void addSpan( float *row, long w, double xa, double xb, double cov )
+{
+	long i, ia, ib;
+
+	xa = fmax( xa, 0.0 );
+	xb = fmin( xb, (double)w );
+	if ( xb <= xa )
+		return;
+	ia = (long)xa;
+	ib = (long)xb;
+	if ( ia == ib )
+	{
+		row[ia] += ( xb - xa ) * cov;
+		return;
+	}
+	row[ia] += ( ia + 1 - xa ) * cov;
+	for ( i = ia + 1; i < ib; ++i )
+		row[i] += cov;
+	if ( ib < w )
+		row[ib] += ( xb - ib ) * cov;
+}
+
+/*
+ * Render the edges to coverage map c of w * h pixels. The active edges
+ * stay sorted by crossing from one scanline to the next, so sorting
+ * them again only costs the edges that crossed.
+ */
+static int rasterise( float *c, long w, long h )
+{
+	size_t next = 0, nact = 0, nx, i, j;
+	const edge_t *e;
+	cross_t t;
+	long y;
+	int k, wind;
+	double ys, xa = 0.0;
+
+	memset( c, 0, w * h * sizeof *c );
+	qsort( ras.e, ras.num, sizeof *ras.e, edgeCmp );
+	if ( 0 != GROW( ras.x, ras.xsz, ras.num ) )
+		return -1;
+	for ( y = 0; y < h; ++y )
+	{
+		for ( k = 0; k < VERIFY_SS; ++k )
+		{
+			ys = y + ( k + 0.5 ) / VERIFY_SS;
+			for ( nx = i = 0; i < nact; ++i )
+			{
+				e = &ras.e[ras.x[i].e];
+				if ( e->y1 <= ys )
+					continue;
+				ras.x[nx].e = ras.x[i].e;
+				ras.x[nx++].x = e->x0 + ( ys - e->y0 ) * e->dxdy;
+			}
+			for ( ; next < ras.num && ras.e[next].y0 <= ys; ++next )
+			{
+				e = &ras.e[next];
+				if ( e->y1 <= ys )
+					continue;
+				ras.x[nx].e = next;
+				ras.x[nx++].x = e->x0 + ( ys - e->y0 ) * e->dxdy;
+			}
+			nact = nx;
+			for ( i = 1; i < nx; ++i )
+			{
+				t = ras.x[i];
+				for ( j = i; j > 0 && ras.x[j - 1].x > t.x; --j )
+					ras.x[j] = ras.x[j - 1];
+				ras.x[j] = t;
+			}
+			for ( wind = 0, i = 0; i < nx; ++i )
+			{
+				if ( 0 == wind )
+					xa = ras.x[i].x;
+				wind += ras.e[ras.x[i].e].dir;
+				if ( 0 == wind )
+					addSpan( c + y * w, w, xa, ras.x[i].x, 1.0 / VERIFY_SS );
+			}
+		}
+	}
+	return 0;
+}
+
+
+/************************************************************
+ *	Hausdorff distance
+ */
+
+static inline double segDist( vec_t p, vec_t a, vec_t b )
+{
+	double abx = b.x - a.x, aby = b.y - a.y, apx = p.x - a.x, apy = p.y - a.y;
+	double l = abx * abx + aby * aby, t = l > 0.0 ? ( apx * abx + apy * aby ) / l : 0.0;
+
+	t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+	apx -= t * abx;
+	apy -= t * aby;
+	return sqrt( apx * apx + apy * apy );
+}
+
+static inline long cellOf( double v, double o, double cs )
+{
+	return (long)floor( ( v - o ) / cs );
+}
+
+static void bounds( const shape_t *d, vec_t *lo, vec_t *hi )
+{
+	size_t i;
+
+	for ( i = 0; i < d->num; ++i )
+	{
+		lo->x = fmin( lo->x, d->pt[i].v.x );
+		lo->y = fmin( lo->y, d->pt[i].v.y );
+		hi->x = fmax( hi->x, d->pt[i].v.x );
+		hi->y = fmax( hi->y, d->pt[i].v.y );
+	}
+}
+
+/*
+ * Add segment i to, or count it for, the grid cells it crosses, going
+ * column by column.
+ */
+static void gridSegment( vec_t a, vec_t b, size_t i, int fill )
+{
+	long x, y, x0, x1, y0, y1;
+	double xa, xb, ya, yb, m;
+	size_t *c;
+
+	if ( a.x > b.x )
+	{
+		vec_t t = a;
+		a = b;
+		b = t;
+	}
+	m = b.x > a.x ? ( b.y - a.y ) / ( b.x - a.x ) : 0.0;
+	x0 = cellOf( a.x, grid.ox, grid.cs );
+	x1 = cellOf( b.x, grid.ox, grid.cs );
+	x0 = x0 < 0 ? 0 : x0;
+	x1 = x1 >= grid.nx ? grid.nx - 1 : x1;
+	for ( x = x0; x <= x1; ++x )
+	{
+		xa = fmax( a.x, grid.ox + x * grid.cs );
+		xb = fmin( b.x, grid.ox + ( x + 1 ) * grid.cs );
+		ya = b.x > a.x ? a.y + ( xa - a.x ) * m : a.y;
+		yb = b.x > a.x ? a.y + ( xb - a.x ) * m : b.y;
+		y0 = cellOf( fmin( ya, yb ), grid.oy, grid.cs );
+		y1 = cellOf( fmax( ya, yb ), grid.oy, grid.cs );
+		y0 = y0 < 0 ? 0 : y0;
+		y1 = y1 >= grid.ny ? grid.ny - 1 : y1;
+		for ( y = y0; y <= y1; ++y )
+		{
+			c = &grid.start[y * grid.nx + x];
+			if ( fill )
+				grid.idx[--*c] = i;
+			else
+				++*c;
+		}
+	}
+}
+
+/*
+ * Bucket the segments in a uniform grid over the outline, with about
+ * as many cells as segments, within limits.
+ */
+static int buildGrid( const seg_t *sg, const shape_t *d )
+{
+	vec_t lo = VEC( HUGE_VAL, HUGE_VAL ), hi = VEC( -HUGE_VAL, -HUGE_VAL );
+	double n = fmin( fmax( sqrt( (double)sg->num ), VERIFY_GRID ), VERIFY_GRID_MAX );
+	size_t i, ncell;
+	int pass;
+
+	bounds( d, &lo, &hi );
+	grid.cs = fmax( fmax( hi.x - lo.x, hi.y - lo.y ) / n, 0.5 );
+	grid.ox = lo.x;
+	grid.oy = lo.y;
+	grid.nx = cellOf( hi.x, lo.x, grid.cs ) + 1;
+	grid.ny = cellOf( hi.y, lo.y, grid.cs ) + 1;
+	ncell = grid.nx * grid.ny;
+	if ( 0 != GROW( grid.start, grid.sz, ncell + 1 ) )
+		return -1;
+	memset( grid.start, 0, ( ncell + 1 ) * sizeof *grid.start );
+	for ( pass = 0; pass < 2; ++pass )
+	{
+		for ( i = 0; i < sg->num; ++i )
+			gridSegment( sg->s[i].a, sg->s[i].b, i, pass );
+		if ( pass )
+			break;
+		// end of each cell; filling backwards leaves the start
+		for ( i = 1; i < ncell; ++i )
+			grid.start[i] += grid.start[i - 1];
+		grid.start[ncell] = grid.start[ncell - 1];
+		if ( 0 != GROW( grid.idx, grid.isz, grid.start[ncell] ? grid.start[ncell] : 1 ) )
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Distance of p to the nearest segment, searching the grid in rings of
+ * cells around p until no closer segment can be found; far off the
+ * grid, when the rings cost more than testing all segments, all are
+ * tested instead.
+ */
+static double nearest( const seg_t *sg, vec_t p )
+{
+	long cx = cellOf( p.x, grid.ox, grid.cs ), cy = cellOf( p.y, grid.oy, grid.cs );
+	long r, rx, ry, x, y, y0, y1, step;
+	size_t k, c, cost = 0;
+	double best = HUGE_VAL;
+
+	// first ring touching the grid
+	rx = cx < 0 ? -cx : cx >= grid.nx ? cx - grid.nx + 1 : 0;
+	ry = cy < 0 ? -cy : cy >= grid.ny ? cy - grid.ny + 1 : 0;
+	for ( r = rx > ry ? rx : ry; best > ( r - 1 ) * grid.cs; ++r )
+	{
+		if ( cost > sg->num )
+		{
+			for ( best = HUGE_VAL, k = 0; k < sg->num; ++k )
+				best = fmin( best, segDist( p, sg->s[k].a, sg->s[k].b ) );
+			break;
+		}
+		y0 = cy - r < 0 ? 0 : cy - r;
+		y1 = cy + r >= grid.ny ? grid.ny - 1 : cy + r;
+		for ( y = y0; y <= y1; ++y )
+		{
+			step = ( y == cy - r || y == cy + r ) ? 1 : 2 * r;
+			x = cx - r;
+			if ( 1 == step && x < 0 )
+				x = 0;
+			for ( ; x <= cx + r && x < grid.nx; x += step )
+			{
+				if ( x < 0 )
+					continue;
+				c = y * grid.nx + x;
+				cost += 1 + grid.start[c + 1] - grid.start[c];
+				for ( k = grid.start[c]; k < grid.start[c + 1]; ++k )
+					best = fmin( best, segDist( p, sg->s[grid.idx[k]].a, sg->s[grid.idx[k]].b ) );
+			}
+		}
+	}
+	return best;
+}
+
+/*
+ * Largest distance of outline a from outline b, sampled along a. The
+ * distance changes no faster than the position, so sampling skips
+ * ahead where it stays below the largest one found, and otherwise
+ * steps by VERIFY_STEP or VERIFY_REL of the distance; very long
+ * outlines get no more than about VERIFY_SAMPLES samples.
+ */
+static double directed( const seg_t *a, const seg_t *b )
+{
+	double h = 0.0, l, t, d, step = 0.0;
+	vec_t u, p;
+	size_t i;
+
+	for ( i = 0; i < a->num; ++i )
+		step += vec_abs( vec_sub( a->s[i].b, a->s[i].a ) );
+	step = fmax( VERIFY_STEP, step / VERIFY_SAMPLES );
+	for ( i = 0; i < a->num; ++i )
+	{
+		p = a->s[i].a;
+		u = vec_sub( a->s[i].b, p );
+		l = vec_abs( u );
+		u = l > 0.0 ? vec_scal( u, 1.0 / l ) : VEC_ZERO;
+		for ( t = 0.0; t < l || 0.0 == t; t += fmax( fmax( step, h - d ), VERIFY_REL * d ) )
+		{
+			d = nearest( b, VEC( p.x + t * u.x, p.y + t * u.y ) );
+			h = fmax( h, d );
+		}
+	}
+	return h;
+}
+
+
+/************************************************************
+ *	Comparison
+ */
+
+/*
+ * Compare output shape out to reference shape ref, both in output
+ * pixels.
+ */
+int verifyShapes( const shape_t *ref, const shape_t *out, verify_t *v )
+{
+	vec_t lo = VEC( HUGE_VAL, HUGE_VAL ), hi = VEC( -HUGE_VAL, -HUGE_VAL );
+	double dim, a, b, smin = 0.0, smax = 0.0;
+	long w, h, i, s;
+
+	memset( v, 0, sizeof *v );
+	for ( s = 0; s < 2; ++s )
+		if ( 0 != flatten( &flat[s], s ? out : ref ) || 0 != segments( &seg[s], &flat[s] ) )
+			return -1;
+	bounds( &flat[0], &lo, &hi );
+	bounds( &flat[1], &lo, &hi );
+	if ( !flat[0].num || !flat[1].num )
+	{
+		v->iou = flat[0].num || flat[1].num ? 0.0 : 1.0;
+		v->hausdorff = flat[0].num || flat[1].num ? HUGE_VAL : 0.0;
+		return 0;
+	}
+
+	// coverage
+	dim = fmax( hi.x - lo.x, hi.y - lo.y ) + 2.0;
+	v->res = fmin( fmax( VERIFY_MIN_DIM / dim, 1.0 ), VERIFY_MAX_RES );
+	if ( ( hi.x - lo.x + 2.0 ) * ( hi.y - lo.y + 2.0 ) * v->res * v->res > VERIFY_MAX_PIX )
+		v->res = sqrt( VERIFY_MAX_PIX / ( ( hi.x - lo.x + 2.0 ) * ( hi.y - lo.y + 2.0 ) ) );
+	w = (long)ceil( ( hi.x - lo.x ) * v->res ) + 2;
+	h = (long)ceil( ( hi.y - lo.y ) * v->res ) + 2;
+	if ( ras.csz < (size_t)( w * h ) )
+	{
+		float *c0 = realloc( ras.cov[0], w * h * sizeof *c0 );
+		float *c1 = c0 ? realloc( ras.cov[1], w * h * sizeof *c1 ) : NULL;
+		if ( c0 )
+			ras.cov[0] = c0;
+		if ( !c1 )
+			return -1;
+		ras.cov[1] = c1;
+		ras.csz = w * h;
+	}
+	lo = vec_sub( lo, VEC( 1.0 / v->res, 1.0 / v->res ) );
+	for ( s = 0; s < 2; ++s )
+		if ( 0 != buildEdges( &seg[s], lo, v->res ) || 0 != rasterise( ras.cov[s], w, h ) )
+			return -1;
+	for ( i = 0; i < w * h; ++i )
+	{
+		a = fmin( ras.cov[0][i], 1.0 );
+		b = fmin( ras.cov[1][i], 1.0 );
+		v->area_ref += a;
+		v->area_out += b;
+		v->diff += fabs( a - b );
+		smin += fmin( a, b );
+		smax += fmax( a, b );
+	}
+	v->iou = smax > 0.0 ? smin / smax : 1.0;
+	a = v->res * v->res;
+	v->area_ref /= a;
+	v->area_out /= a;
+	v->diff /= a;
+
+	// outline distance, both ways
+	for ( s = 0; s < 2; ++s )
+	{
+		if ( 0 != buildGrid( &seg[1 - s], &flat[1 - s] ) )
+			return -1;
+		v->hausdorff = fmax( v->hausdorff, directed( &seg[s], &seg[1 - s] ) );
+	}
+	return 0;
+}
+
+void verifyFree( void )
+{
+	shpFree( &flat[0] );
+	shpFree( &flat[1] );
+	free( seg[0].s );
+	free( seg[1].s );
+	memset( seg, 0, sizeof seg );
+	free( ras.e );
+	free( ras.x );
+	free( ras.cov[0] );
+	free( ras.cov[1] );
+	free( grid.start );
+	free( grid.idx );
+	memset( &ras, 0, sizeof ras );
+	memset( &grid, 0, sizeof grid );
+}
+
+/* EOF */
@@ -0,0 +1,39 @@
+/*
+ * Geometric fidelity check of converted shapes.
+ *
+ * Project: svg2ass
+ *    File: verify.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_VERIFY_INCLUDED
+#define H_VERIFY_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include "shape.h"
+
+typedef struct {
+	double area_ref;	// area covered by the reference shape [px^2]
+	double area_out;	// area covered by the output shape [px^2]
+	double diff;		// sum of absolute coverage differences [px^2]
+	double iou;			// intersection over union of the coverage
+	double hausdorff;	// Hausdorff distance of the outlines [px]
+	double res;			// raster resolution, pixels per px
+} verify_t;
+
+int verifyShapes( const shape_t *ref, const shape_t *out, verify_t *v );
+void verifyFree( void );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_VERIFY_INCLUDED
+
+/* EOF */
@@ -0,0 +1,2 @@
+#define VERSION	"0.1.2"
+#define SVNVER "git3e1ad40-rls"
@@ -0,0 +1,142 @@
+/*
+ * Wait for changes to a file.
+ *
+ * Project: svg2ass
+ *    File: watch.c
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ *
+ * The directory containing the file is watched rather than the file
+ * itself, as editors commonly save by writing a new file and renaming
+ * it over the old one. Bursts of events, as caused by a single save,
+ * are reported as one change. Only implemented using Linux inotify.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "watch.h"
+
+#ifdef __linux__
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+// quiet period ending a burst of events [ms]
+#define WATCH_SETTLE	50
+
+int watchOpen( watch_t *w, const char *path )
+{
+	char *p;
+
+	memset( w, 0, sizeof *w );
+	if ( NULL == ( w->dir = malloc( strlen( path ) + 3 ) ) )
+		return -1;
+	strcpy( w->dir, path );
+	if ( NULL != ( p = strrchr( w->dir, '/' ) ) )
+	{
+		*p = '\0';
+		w->base = path + ( p - w->dir ) + 1;
+		if ( p == w->dir )
+			strcpy( w->dir, "/" );
+	}
+	else
+	{
+		strcpy( w->dir, "." );
+		w->base = path;
+	}
+	if ( 0 > ( w->fd = inotify_init() )
+		|| 0 > inotify_add_watch( w->fd, w->dir, IN_CLOSE_WRITE | IN_MOVED_TO ) )
+	{
+		watchClose( w );
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Read pending events, return 1 if any of them concerns the file.
+ */
+static int readEvents( watch_t *w )
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t n;
+	char *p;
+	int hit = 0;
+
+	if ( 0 >= ( n = read( w->fd, buf, sizeof buf ) ) )
+		return -1;
+	for ( p = buf; p < buf + n; p += sizeof *ev + ev->len )
+	{
+		ev = (const struct inotify_event *)p;
+		if ( ev->len && 0 == strcmp( ev->name, w->base ) )
+			hit = 1;
+	}
+	return hit;
+}
+
+/*
+ * Block until the file has changed.
+ */
+int watchWait( watch_t *w )
+{
+	struct pollfd pfd;
+	int r, hit = 0;
+
+	pfd.fd = w->fd;
+	pfd.events = POLLIN;
+	for ( ;; )
+	{
+		r = poll( &pfd, 1, hit ? WATCH_SETTLE : -1 );
+		if ( 0 > r && EINTR == errno )
+			continue;
+		if ( 0 > r )
+			return -1;
+		if ( 0 == r )
+			return 0;	// burst settled
+		if ( 0 > ( r = readEvents( w ) ) )
+			return -1;
+		hit |= r;
+	}
+}
+
+void watchClose( watch_t *w )
+{
+	if ( 0 <= w->fd )
+		close( w->fd );
+	free( w->dir );
+	memset( w, 0, sizeof *w );
+	w->fd = -1;
+}
+
+#else	// __linux__
+
+int watchOpen( watch_t *w, const char *path )
+{
+	(void)path;
+	memset( w, 0, sizeof *w );
+	w->fd = -1;
+	errno = ENOSYS;
+	return -1;
+}
+
+int watchWait( watch_t *w )
+{
+	(void)w;
+	errno = ENOSYS;
+	return -1;
+}
+
+void watchClose( watch_t *w )
+{
+	(void)w;
+}
+
+#endif	// __linux__
+
+/* EOF */
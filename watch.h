@@ -0,0 +1,35 @@
+/*
+ * Wait for changes to a file.
+ *
+ * Project: svg2ass
+ *    File: watch.h
+ * Created: 2026-10-18
+ *  Author: Urban Wallasch
+ *
+ * See LICENSE file for more details.
+ */
+
+#ifndef H_WATCH_INCLUDED
+#define H_WATCH_INCLUDED
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+typedef struct {
+	int fd;				// notification descriptor
+	char *dir;			// watched directory
+	const char *base;	// file name within dir
+} watch_t;
+
+int watchOpen( watch_t *w, const char *path );
+int watchWait( watch_t *w );
+void watchClose( watch_t *w );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// H_WATCH_INCLUDED
+
+/* EOF */